@@ -1,4 +1,5 @@
 #include "phys_utils.h"
+#include <cstddef>
 #include <glm\glm.hpp>
 #include <graphics_framework.h>
 
@@ -11,6 +12,8 @@ target_camera cam;
 effect effP;
 effect effB;
 effect effG;
+effect effI;
+effect effL;
 glm::mat4 PV;
 directional_light light;
 material mat;
@@ -29,6 +32,14 @@ void Init() {
   effG.add_shader("shaders/phys_grid.vert", GL_VERTEX_SHADER);
   effG.add_shader("shaders/phys_grid.frag", GL_FRAGMENT_SHADER);
   effG.build();
+  effI = effect();
+  effI.add_shader("shaders/phys_instanced.vert", GL_VERTEX_SHADER);
+  effI.add_shader("shaders/phys_instanced.frag", GL_FRAGMENT_SHADER);
+  effI.build();
+  effL = effect();
+  effL.add_shader("shaders/phys_lines.vert", GL_VERTEX_SHADER);
+  effL.add_shader("shaders/phys_lines.frag", GL_FRAGMENT_SHADER);
+  effL.build();
   cam.set_position(vec3(10.0f, 10.0f, 10.0f));
   cam.set_target(vec3(0.0f, 0.0f, 0.0f));
   auto aspect = static_cast<float>(renderer::get_screen_width()) / static_cast<float>(renderer::get_screen_height());
@@ -167,107 +178,145 @@ void DrawLineCross(const glm::vec3 &p0, float radius, const bool depth, const RG
 
 
 
-void DrawGrid(const glm::vec3 *points, const size_t amount, const size_t rowsize, const PlaneType pt) {
-  if (pt == PlaneType::points) {
-    renderer::bind(effB);
-    static bool ready = false;
-    static unsigned int vao;
-    static unsigned int vbo;
-    if (!ready) {
-      glGenVertexArrays(1, &vao);
-      glBindVertexArray(vao);
-      glGenBuffers(1, &vbo);
-      ready = true;
+//the point array DrawGrid as a grid source, indices rebuilt only when the row size changes
+class PointGrid : public GridSource {
+public:
+  PointGrid() : points_(nullptr), amount_(0), rows_(0), version_(0) {}
+  void Set(const glm::vec3 *points, size_t amount, size_t rows) {
+    points_ = points;
+    amount_ = amount;
+    if (rows != rows_) {
+      rows_ = rows;
+      BuildGridIndices(rows_, indices_);
+      ++version_;
     }
+  }
+  size_t Rows() const { return rows_; }
+  size_t Stride() const { return sizeof(glm::vec3); }
+  const uint32_t *Indices(size_t &count, uint32_t &version) const {
+    count = indices_.size();
+    version = version_;
+    return indices_.data();
+  }
+  void Pack(void *dst) {
+    glm::vec3 *out = static_cast<glm::vec3 *>(dst);
+    const size_t count = rows_ * rows_;
+    for (size_t i = 0; i < count; ++i) {
+      out[i] = i < amount_ ? points_[i] : glm::vec3(0.0f);
+    }
+  }
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * amount, &points[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), NULL);
+private:
+  const glm::vec3 *points_;
+  size_t amount_;
+  size_t rows_;
+  uint32_t version_;
+  std::vector<uint32_t> indices_;
+};
 
-    GLfloat colour[4];
-    RGBAInt32 col = ORANGE;
-    col.tofloat(colour);
-    glUniformMatrix4fv(effB.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(PV));
-    glUniform4fv(effB.get_uniform_location("colour_override"), 1, &colour[0]);
+void DrawGrid(const glm::vec3 *points, const size_t amount, const size_t rowsize, const PlaneType pt) {
+  static PointGrid grid;
+  grid.Set(points, amount, rowsize);
+  DrawGrid(grid, pt);
+}
 
-    glDrawArrays(GL_POINTS, 0, amount);
-    glBindVertexArray(NULL);
+void DrawGrid(GridSource &source, const PlaneType pt) {
+  static bool ready = false;
+  static unsigned int vao;
+  static unsigned int vbo;
+  static unsigned int ibo;
+  //source and version of the indices in ibo
+  static const GridSource *indexSource = nullptr;
+  static uint32_t indexVersion = 0;
+  static size_t indexCount = 0;
+  if (!ready) {
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ibo);
+    ready = true;
+  }
+  const size_t rows = source.Rows();
+  const size_t vertices = rows * rows;
+  if (!vertices) {
     return;
   }
-  else {
-    const size_t TriangleCount = amount - 2;
-  //  const size_t IndiceCount = TriangleCount * 3;  I'm not smart enough to do this
-    renderer::bind(effB);
-    static bool ready = false;
-    static unsigned int vao;
-    static unsigned int vbo;
-    static unsigned int ibo;
-    // Generate a buffer for the indices
-    
-    if (!ready) {
-      glGenVertexArrays(1, &vao);
-      glBindVertexArray(vao);
-      glGenBuffers(1, &vbo);
-      glGenBuffers(1, &ibo);
-      ready = true;
-    }
-
-    //setup indices
-    std::vector<unsigned int> indices;
-    {
-      for (int x = 0; x < rowsize-1; x++)
-      {
-
-        for (int y = 0; y < rowsize - 1; y++)
-        {
-          //Build right tris, 
-          indices.push_back((x*rowsize) + y);
-          indices.push_back((x*rowsize) + y+1);
-          indices.push_back((x*rowsize) + (y+1)+rowsize);
-          //Build Left Tris
-          indices.push_back((x*rowsize) + y);
-          indices.push_back((x*rowsize) + (y + 1) + rowsize);
-          indices.push_back((x*rowsize) + y+ rowsize);
-        }
-      }
-    }
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+  const size_t stride = source.Stride();
+  //solid grids with normals are lit like every other shape, the rest are flat colour
+  const size_t normalOffset = source.NormalOffset();
+  const bool shaded = pt == PlaneType::solid && normalOffset;
+  renderer::bind(shaded ? effP : effB);
+  glBindVertexArray(vao);
 
-    //setup verts
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * amount, &points[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), NULL);
+  //setup verts: orphan last frame's storage so the driver never waits for the GPU to be done with it,
+  //and let the source write the new vertices straight into the mapped buffer
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertices * stride, NULL, GL_STREAM_DRAW);
+  void *dst = glMapBufferRange(GL_ARRAY_BUFFER, 0, vertices * stride, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (dst) {
+    source.Pack(dst);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(stride), NULL);
+  if (normalOffset) {
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(stride), (void *)normalOffset);
+  } else {
+    glDisableVertexAttribArray(2);
+  }
 
+  RGBAInt32 col = pt == PlaneType::points ? ORANGE : RED;
+  if (shaded) {
+    //the vertices are already in world space
+    const mat4 M(1.0f);
+    const mat3 N(1.0f);
+    mat.set_diffuse(col.tovec4());
+    renderer::bind(mat, "mat");
+    renderer::bind(light, "light");
+    glUniformMatrix4fv(effP.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(PV));
+    glUniformMatrix4fv(effP.get_uniform_location("M"), 1, GL_FALSE, value_ptr(M));
+    glUniformMatrix3fv(effP.get_uniform_location("N"), 1, GL_FALSE, value_ptr(N));
+  } else {
     GLfloat colour[4];
-    RGBAInt32 col = RED;
     col.tofloat(colour);
     glUniformMatrix4fv(effB.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(PV));
     glUniform4fv(effB.get_uniform_location("colour_override"), 1, &colour[0]);
+  }
 
-    if (pt == PlaneType::wireframe) {
-      glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    }
+  if (pt == PlaneType::points) {
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(vertices));
+    glBindVertexArray(NULL);
+    return;
+  }
 
-	glDisable(GL_CULL_FACE);
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, (void*)0);
-	glEnable(GL_CULL_FACE);
-    if (pt == PlaneType::wireframe) {
-      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    }
+  //setup indices, the topology only changes with the grid size
+  size_t count;
+  uint32_t version;
+  const uint32_t *indices = source.Indices(count, version);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  if (indexSource != &source || indexVersion != version) {
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+    indexSource = &source;
+    indexVersion = version;
+    indexCount = count;
+  }
 
-    glBindVertexArray(NULL);
+  if (pt == PlaneType::wireframe) {
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+  }
+  glDisable(GL_CULL_FACE);
+  glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT, (void *)0);
+  glEnable(GL_CULL_FACE);
+  if (pt == PlaneType::wireframe) {
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  }
 
-    if (CHECK_GL_ERROR) {
-      std::cerr << "ERROR Drawing Grid" << std::endl;
-      throw std::runtime_error("ERROR Drawing Grid");
-    }
+  glBindVertexArray(NULL);
 
+  if (CHECK_GL_ERROR) {
+    std::cerr << "ERROR Drawing Grid" << std::endl;
+    throw std::runtime_error("ERROR Drawing Grid");
   }
 }
 
@@ -318,6 +367,91 @@ const RGBAInt32 RandomColour() {
   return c;
 }
 
+//streams the instances to buffer, orphaning last frame's storage
+static void streamBuffer(unsigned int buffer, const void *data, size_t bytes) {
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+}
+
+//all the lines of one list in a single draw
+static void flushLines(const std::vector<LineVertex> &lines, const bool depth) {
+  static bool ready = false;
+  static unsigned int vao;
+  static unsigned int vbo;
+  if (lines.empty()) {
+    return;
+  }
+  if (!ready) {
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void *)offsetof(LineVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LineVertex), (void *)offsetof(LineVertex, colour));
+    ready = true;
+  }
+  renderer::bind(effL);
+  glBindVertexArray(vao);
+  streamBuffer(vbo, lines.data(), lines.size() * sizeof(LineVertex));
+  glUniformMatrix4fv(effL.get_uniform_location("MVP"), 1, GL_FALSE, value_ptr(PV));
+  if (!depth) {
+    glDisable(GL_DEPTH_TEST);
+  }
+  glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(lines.size()));
+  if (!depth) {
+    glEnable(GL_DEPTH_TEST);
+  }
+  glBindVertexArray(NULL);
+}
+
+void FlushDebugDraw() {
+  DebugBatch &batch = GetDebugBatch();
+  const std::vector<SphereInstance> &spheres = batch.Spheres();
+  if (!spheres.empty()) {
+    //a sphere of its own, its vertex array gets the per instance centre, radius and colour
+    static geometry geom = geometry_builder::create_sphere();
+    static bool ready = false;
+    static unsigned int instances;
+    if (!ready) {
+      glGenBuffers(1, &instances);
+      glBindVertexArray(geom.get_array_object());
+      glBindBuffer(GL_ARRAY_BUFFER, instances);
+      glEnableVertexAttribArray(5);
+      glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance), (void *)offsetof(SphereInstance, centre));
+      glVertexAttribDivisor(5, 1);
+      glEnableVertexAttribArray(6);
+      glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SphereInstance),
+                            (void *)offsetof(SphereInstance, colour));
+      glVertexAttribDivisor(6, 1);
+      ready = true;
+    }
+    renderer::bind(effI);
+    renderer::bind(mat, "mat");
+    renderer::bind(light, "light");
+    glUniformMatrix4fv(effI.get_uniform_location("PV"), 1, GL_FALSE, value_ptr(PV));
+    glBindVertexArray(geom.get_array_object());
+    streamBuffer(instances, spheres.data(), spheres.size() * sizeof(SphereInstance));
+    const GLsizei count = static_cast<GLsizei>(spheres.size());
+    if (geom.get_index_buffer()) {
+      glDrawElementsInstanced(geom.get_type(), geom.get_index_count(), GL_UNSIGNED_INT, (void *)0, count);
+    } else {
+      glDrawArraysInstanced(geom.get_type(), 0, geom.get_vertex_count(), count);
+    }
+    glBindVertexArray(NULL);
+  }
+  flushLines(batch.Lines(), true);
+  flushLines(batch.OverlayLines(), false);
+  batch.Clear();
+
+  if (CHECK_GL_ERROR) {
+    std::cerr << "ERROR Flushing debug draw" << std::endl;
+    throw std::runtime_error("ERROR Flushing debug draw");
+  }
+}
+
 void DrawScene() {
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -1,6 +1,10 @@
 #pragma once
-#include <glm\glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
 #include <iostream>
+#include <utility>
+#include <vector>
 #define RED                                                                                                            \
   { 4278190335 }
 #define GREEN                                                                                                          \
@@ -28,11 +32,140 @@ union RGBAInt32 {
   uint32_t i;
   unsigned char b[4];
   void tofloat(float *const arr) const;
-  glm::vec4 RGBAInt32::tovec4() const;
+  glm::vec4 tovec4() const;
 };
 
+//Vertices and triangles of a rows x rows grid, written straight into the buffers DrawGrid streams to the GPU.
+//Knows nothing about GL, so the packing can be run and measured without a context.
+class GridSource {
+public:
+  virtual ~GridSource() {}
+  //vertices per row
+  virtual size_t Rows() const = 0;
+  //bytes per vertex, the position is the first 3 floats
+  virtual size_t Stride() const = 0;
+  //byte offset of the vertex normal (3 floats), 0 when the vertices have none
+  virtual size_t NormalOffset() const { return 0; }
+  //triangle list over the vertices; version changes whenever the list does, so it is only uploaded then
+  virtual const uint32_t *Indices(size_t &count, uint32_t &version) const = 0;
+  //writes Rows() * Rows() vertices of Stride() bytes to dst
+  virtual void Pack(void *dst) = 0;
+};
+
+//triangle list of a rows x rows grid, two triangles per cell
+inline void BuildGridIndices(size_t rows, std::vector<uint32_t> &indices) {
+  indices.clear();
+  if (rows < 2) {
+    return;
+  }
+  indices.reserve((rows - 1) * (rows - 1) * 6);
+  for (size_t x = 0; x < rows - 1; ++x) {
+    for (size_t y = 0; y < rows - 1; ++y) {
+      const uint32_t i = static_cast<uint32_t>(x * rows + y);
+      const uint32_t r = static_cast<uint32_t>(rows);
+      // right triangle, then left triangle
+      indices.push_back(i);
+      indices.push_back(i + 1);
+      indices.push_back(i + 1 + r);
+      indices.push_back(i);
+      indices.push_back(i + 1 + r);
+      indices.push_back(i + r);
+    }
+  }
+}
+
+//one sphere of a batch, laid out as the instance attributes of the instanced sphere shader
+struct SphereInstance {
+  glm::vec3 centre;
+  float radius;
+  RGBAInt32 colour;
+};
+
+//one end of a batched line
+struct LineVertex {
+  glm::vec3 position;
+  RGBAInt32 colour;
+};
+
+//Debug primitives recorded during a frame, drawn by FlushDebugDraw with one draw call per kind of primitive.
+//Recording only fills arrays, so it runs without a GL context. The arrays keep their size between frames.
+class DebugBatch {
+public:
+  DebugBatch() : records_(0), growths_(0) {}
+  //count spheres of the same radius, colours has one colour per sphere or is null for col
+  void AddSpheres(const glm::vec3 *centres, size_t count, float radius, const RGBAInt32 *colours, RGBAInt32 col) {
+    const size_t capacity = spheres_.capacity();
+    const size_t first = spheres_.size();
+    spheres_.resize(first + count);
+    for (size_t i = 0; i < count; ++i) {
+      SphereInstance &s = spheres_[first + i];
+      s.centre = centres[i];
+      s.radius = radius;
+      s.colour = colours ? colours[i] : col;
+    }
+    growths_ += spheres_.capacity() != capacity;
+    ++records_;
+  }
+  //count lines, depth tested or drawn over everything
+  void AddLines(const std::pair<glm::vec3, glm::vec3> *lines, size_t count, RGBAInt32 col, bool depth) {
+    std::vector<LineVertex> &out = depth ? lines_ : overlayLines_;
+    const size_t capacity = out.capacity();
+    const size_t first = out.size();
+    out.resize(first + count * 2);
+    for (size_t i = 0; i < count; ++i) {
+      out[first + 2 * i].position = lines[i].first;
+      out[first + 2 * i].colour = col;
+      out[first + 2 * i + 1].position = lines[i].second;
+      out[first + 2 * i + 1].colour = col;
+    }
+    growths_ += out.capacity() != capacity;
+    ++records_;
+  }
+  //empties the batch for the next frame, keeping the memory
+  void Clear() {
+    spheres_.clear();
+    lines_.clear();
+    overlayLines_.clear();
+    records_ = 0;
+  }
+
+  const std::vector<SphereInstance> &Spheres() const { return spheres_; }
+  const std::vector<LineVertex> &Lines() const { return lines_; }
+  const std::vector<LineVertex> &OverlayLines() const { return overlayLines_; }
+  //Draw calls recorded since the last clear, they all end up in at most 3 real draws
+  size_t Records() const { return records_; }
+  //times one of the arrays had to grow since the batch was made
+  size_t Growths() const { return growths_; }
+
+private:
+  std::vector<SphereInstance> spheres_;
+  std::vector<LineVertex> lines_;
+  std::vector<LineVertex> overlayLines_;
+  size_t records_;
+  size_t growths_;
+};
+
+//batch filled by DrawSpheres and DrawLines
+inline DebugBatch &GetDebugBatch() {
+  static DebugBatch batch;
+  return batch;
+}
+
+//records count spheres for the next FlushDebugDraw, colours is one per sphere or null for col
+inline void DrawSpheres(const glm::vec3 *centres, size_t count, float radius, const RGBAInt32 *colours = nullptr,
+                        const RGBAInt32 col = RED) {
+  GetDebugBatch().AddSpheres(centres, count, radius, colours, col);
+}
+//records count lines for the next FlushDebugDraw
+inline void DrawLines(const std::pair<glm::vec3, glm::vec3> *lines, size_t count, const bool depth = true,
+                      const RGBAInt32 col = RED) {
+  GetDebugBatch().AddLines(lines, count, col, depth);
+}
+
 const RGBAInt32 RandomColour();
 void DrawScene();
+//draws everything recorded by DrawSpheres and DrawLines since the last flush, one instanced draw per kind
+void FlushDebugDraw();
 void Init();
 void Update(double delta_time);
 void SetCameraPos(const glm::vec3 &p0);
@@ -48,6 +181,8 @@ void DrawSphere(const glm::vec3 &p0, float radius = 1.0f, const RGBAInt32 col =
 void DrawCube(const glm::vec3 &p0, const glm::vec3 &scale = glm::vec3(1.0f, 1.0f, 1.0f), const RGBAInt32 col = RED);
 void DrawCube(const glm::mat4 &m, const RGBAInt32 col = RED);
 void DrawGrid(const glm::vec3* points, const size_t amount, const size_t rowsize, const PlaneType pt = PlaneType::points);
+//streams the vertices of source into an orphaned buffer and draws them, indices are uploaded once per version
+void DrawGrid(GridSource &source, const PlaneType pt = PlaneType::wireframe);
 }
 
 glm::vec3 projectOntoPlane(const glm::vec3 &point, const glm::vec3 &planeNormal,
@@ -0,0 +1,29 @@
+#version 410
+
+// The projection * view matrix, every instance places itself in the world
+uniform mat4 PV;
+
+// Incoming position
+layout (location = 0) in vec3 position;
+// Incoming normal
+layout (location = 2) in vec3 normal;
+// Per instance centre (xyz) and radius (w)
+layout (location = 5) in vec4 centre_radius;
+// Per instance colour
+layout (location = 6) in vec4 instance_colour;
+
+// Outgoing position
+layout (location = 0) out vec3 vertex_position;
+// Outgoing normal
+layout (location = 1) out vec3 transformed_normal;
+// Outgoing colour
+layout (location = 2) out vec4 vertex_colour;
+
+void main()
+{
+	// a uniform scale and a translation, the normal needs no transform
+	vertex_position = position * centre_radius.w + centre_radius.xyz;
+	gl_Position = PV * vec4(vertex_position, 1);
+	transformed_normal = normal;
+	vertex_colour = instance_colour;
+}
@@ -0,0 +1,8 @@
+#version 440
+layout (location = 0) in vec4 vertex_colour;
+layout (location = 0) out vec4 out_colour;
+
+void main()
+{
+	out_colour = vertex_colour;
+}
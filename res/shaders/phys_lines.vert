@@ -0,0 +1,11 @@
+#version 440
+uniform mat4 MVP;
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec4 colour;
+layout (location = 0) out vec4 vertex_colour;
+
+void main()
+{
+	gl_Position = MVP * vec4(position, 1.0);
+	vertex_colour = colour;
+}
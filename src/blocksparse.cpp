@@ -0,0 +1,42 @@
+#include "blocksparse.h"
+#include <algorithm>
+
+using namespace std;
+
+void InvertBlock(const float *m, float *inv) {
+  const float c00 = m[4] * m[8] - m[5] * m[5];
+  const float c01 = m[2] * m[5] - m[1] * m[8];
+  const float c02 = m[1] * m[5] - m[2] * m[4];
+  const float det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+  fill(inv, inv + 9, 0.0f);
+  if (!(det > 0.0f)) {
+    // singular or indefinite, fall back to the diagonal
+    inv[0] = 1.0f / m[0];
+    inv[4] = 1.0f / m[4];
+    inv[8] = 1.0f / m[8];
+    return;
+  }
+  const float d = 1.0f / det;
+  inv[0] = c00 * d;
+  inv[1] = inv[3] = c01 * d;
+  inv[2] = inv[6] = c02 * d;
+  inv[4] = (m[0] * m[8] - m[2] * m[2]) * d;
+  inv[5] = inv[7] = (m[1] * m[2] - m[0] * m[5]) * d;
+  inv[8] = (m[0] * m[4] - m[1] * m[1]) * d;
+}
+
+void BlockSparseMatrix::Multiply(const float *x, float *y, size_t begin, size_t end) const {
+  for (size_t i = begin; i < end; ++i) {
+    float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+    for (uint32_t s = rowStart[i]; s < rowStart[i + 1]; ++s) {
+      const float *b = &blocks[9 * s];
+      const float *v = x + 3 * column[s];
+      sx += b[0] * v[0] + b[1] * v[1] + b[2] * v[2];
+      sy += b[3] * v[0] + b[4] * v[1] + b[5] * v[2];
+      sz += b[6] * v[0] + b[7] * v[1] + b[8] * v[2];
+    }
+    y[3 * i] = sx;
+    y[3 * i + 1] = sy;
+    y[3 * i + 2] = sz;
+  }
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Square matrix of 3x3 blocks in compressed rows (BSR): the blocks of block row i are rowStart[i] to rowStart[i + 1] - 1,
+//in column order, each one 9 floats in row major order.
+struct BlockSparseMatrix {
+  std::vector<uint32_t> rowStart;
+  std::vector<uint32_t> column;
+  std::vector<float> blocks;
+
+  size_t Rows() const { return rowStart.empty() ? 0 : rowStart.size() - 1; }
+  size_t Blocks() const { return column.size(); }
+  //y = A x for block rows [begin, end), x and y hold 3 floats per block row
+  void Multiply(const float *x, float *y, size_t begin, size_t end) const;
+};
+
+//inverse of a symmetric 3x3 block (9 floats, row major), through its cofactors. Falls back to the inverse of the
+//diagonal when the block isn't positive definite.
+void InvertBlock(const float *m, float *inv);
@@ -0,0 +1,97 @@
+#include "broadphase.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+UniformGrid::UniformGrid()
+    : x_(nullptr), y_(nullptr), z_(nullptr), r_(nullptr), count_(0), cellSize_(1.0f), invCell_(1.0f), mask_(0) {}
+
+int32_t UniformGrid::Cell(float v) const {
+  // clamped so far away spheres can't overflow the cell coordinates
+  const float c = floorf(v * invCell_);
+  return static_cast<int32_t>(max(-1.0e9f, min(1.0e9f, c)));
+}
+
+size_t UniformGrid::Bucket(int32_t cx, int32_t cy, int32_t cz) const {
+  const uint32_t h = (static_cast<uint32_t>(cx) * 73856093u) ^ (static_cast<uint32_t>(cy) * 19349663u) ^
+                     (static_cast<uint32_t>(cz) * 83492791u);
+  return h & mask_;
+}
+
+void UniformGrid::Build(const float *x, const float *y, const float *z, const float *radius, size_t count) {
+  x_ = x;
+  y_ = y;
+  z_ = z;
+  r_ = radius;
+  count_ = count;
+
+  float maxRadius = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    maxRadius = max(maxRadius, radius[i]);
+  }
+  cellSize_ = max(2.0f * maxRadius, 1.0e-4f);
+  invCell_ = 1.0f / cellSize_;
+
+  // about two buckets per sphere, power of two so the hash is a mask
+  size_t buckets = 1;
+  while (buckets < count * 2) {
+    buckets <<= 1;
+  }
+  mask_ = buckets - 1;
+
+  cx_.resize(count);
+  cy_.resize(count);
+  cz_.resize(count);
+  sorted_.resize(count);
+  start_.assign(buckets + 1, 0);
+
+  // counting sort of the spheres by bucket
+  for (size_t i = 0; i < count; ++i) {
+    cx_[i] = Cell(x[i]);
+    cy_[i] = Cell(y[i]);
+    cz_[i] = Cell(z[i]);
+    ++start_[Bucket(cx_[i], cy_[i], cz_[i]) + 1];
+  }
+  for (size_t b = 0; b < buckets; ++b) {
+    start_[b + 1] += start_[b];
+  }
+  for (size_t i = 0; i < count; ++i) {
+    const size_t b = Bucket(cx_[i], cy_[i], cz_[i]);
+    sorted_[start_[b]++] = static_cast<uint32_t>(i);
+  }
+  // the fill above moved every start to the next bucket, shift them back
+  for (size_t b = buckets; b > 0; --b) {
+    start_[b] = start_[b - 1];
+  }
+  start_[0] = 0;
+}
+
+void UniformGrid::FindPairs(vector<SpherePair> &pairs) const { FindPairs(pairs, 0, count_); }
+
+void UniformGrid::FindPairs(vector<SpherePair> &pairs, size_t begin, size_t end) const {
+  // own cell plus the 13 neighbours "after" it, every pair of cells is visited once
+  static const int32_t offsets[14][3] = {{0, 0, 0},  {0, 0, 1},   {0, 1, -1}, {0, 1, 0},  {0, 1, 1},
+                                         {1, -1, -1}, {1, -1, 0}, {1, -1, 1}, {1, 0, -1}, {1, 0, 0},
+                                         {1, 0, 1},  {1, 1, -1},  {1, 1, 0},  {1, 1, 1}};
+  for (size_t i = begin; i < end; ++i) {
+    for (int n = 0; n < 14; ++n) {
+      const int32_t cx = cx_[i] + offsets[n][0];
+      const int32_t cy = cy_[i] + offsets[n][1];
+      const int32_t cz = cz_[i] + offsets[n][2];
+      const size_t b = Bucket(cx, cy, cz);
+      for (uint32_t k = start_[b]; k < start_[b + 1]; ++k) {
+        const uint32_t j = sorted_[k];
+        // skip spheres of other cells that share the bucket, and in the own cell take every pair once
+        if (cx_[j] != cx || cy_[j] != cy || cz_[j] != cz || (n == 0 && j <= i)) {
+          continue;
+        }
+        const float reach = r_[i] + r_[j];
+        if (fabsf(x_[j] - x_[i]) <= reach && fabsf(y_[j] - y_[i]) <= reach && fabsf(z_[j] - z_[i]) <= reach) {
+          SpherePair p = {static_cast<uint32_t>(min<size_t>(i, j)), static_cast<uint32_t>(max<size_t>(i, j))};
+          pairs.push_back(p);
+        }
+      }
+    }
+  }
+}
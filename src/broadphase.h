@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//candidate pair of spheres, a < b
+struct SpherePair {
+  uint32_t a, b;
+};
+
+//Uniform grid broadphase for spheres, hashed so the grid has no bounds.
+//The cell size is the largest diameter, so overlapping spheres are always in neighbouring cells.
+//Buffers are kept between builds, so once warmed up it does not allocate.
+class UniformGrid {
+public:
+  UniformGrid();
+  //bins count spheres, the arrays must stay alive until the pairs are found
+  void Build(const float *x, const float *y, const float *z, const float *radius, size_t count);
+  //appends every pair of spheres whose bounding boxes overlap
+  void FindPairs(std::vector<SpherePair> &pairs) const;
+  //same, only the pairs whose first sphere in build order is in [begin, end), so ranges can be searched in parallel
+  void FindPairs(std::vector<SpherePair> &pairs, size_t begin, size_t end) const;
+  size_t Size() const { return count_; }
+  float CellSize() const { return cellSize_; }
+
+private:
+  size_t Bucket(int32_t cx, int32_t cy, int32_t cz) const;
+  int32_t Cell(float v) const;
+
+  const float *x_;
+  const float *y_;
+  const float *z_;
+  const float *r_;
+  size_t count_;
+  float cellSize_;
+  float invCell_;
+  size_t mask_;
+  //cell of every sphere
+  std::vector<int32_t> cx_, cy_, cz_;
+  //spheres of bucket b are sorted_[start_[b]] to sorted_[start_[b + 1] - 1]
+  std::vector<uint32_t> start_;
+  std::vector<uint32_t> sorted_;
+};
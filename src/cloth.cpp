@@ -0,0 +1,418 @@
+#define GLM_ENABLE_EXPERIMENTAL
+#include "cloth.h"
+#include <glm/glm.hpp>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+using namespace glm;
+
+//Vectors containing particles and springs of the cloth
+vector<Entity *> ClothParticles;
+//storage of the cloth particles, built and freed in one go
+ParticlePool clothPool;
+SpringTopology clothSprings;
+SelfCollision clothSelfCollision;
+SleepTiles clothSleep;
+//spring constants as seen by the physics tick
+static SpringParams clothParams;
+//cloth is composed of 15x15 particles
+int rows = 15;
+//Springs and damper constants 
+float stretchConstant = 95.0f;
+float shearConstant = 90.0f;
+float bendingConstant = 80.0f;
+float diagonalBendingConstant = 20.0f;
+float dampingFactor = 90.0f;
+//natural length of the cloth set to distance between particles
+float naturalLength = 0.3f;
+//particles closer than this push each other away, enough to close the gap in the middle of a grid square
+float clothThickness = 0.75f * naturalLength;
+
+
+//method to create the cloth particles at a given position and with a given mass 
+unique_ptr<Entity> CreateParticle(float xPos, float yPos, float zPos, double myMass) {
+	//creates new entity
+	unique_ptr<Entity> ent(new Entity());
+	//set position at passed values to the method
+	ent->SetPosition(vec3(xPos, yPos, zPos));
+	//creating new cPhysics, that will contain all the particle physics
+	cPhysics *phys = new cPhysics();
+	//set mass to given mass
+	phys->SetMass(myMass);
+	//creating new component using cPhysics created before
+	unique_ptr<Component> physComponent(phys);
+	//adding the component created to the entity
+	ent->AddComponent(physComponent);
+	//creating a new sphere collider for the particle
+	cSphereCollider *coll = new cSphereCollider();
+	//setting collider radius to 0.3
+	coll->radius = 0.03f;
+	//adding the collider to the entity
+	//(the render component is attached by the application, so the cloth can be built headless)
+	ent->AddComponent(unique_ptr<Component>(coll));
+	//returning entity
+	return ent;
+}
+
+//Method to get specific particle in the list of Cloth Particles, based on its cartesian coordinates 
+cPhysics *getParticle(int x, int z)
+{
+	//getting the cPhysics of the particle (to get particles attributes) and converting its coordinates into correct index in the list like:
+	//(rows = 16) if coordinates of the particle are (1 , 3), its index will be : 1 * 15 + 3 = 18. 
+	auto p = ClothParticles[x * rows + z]->getComponent<cPhysics>();
+	return p;
+}
+
+//Method to create the springs of a size x size cloth whose particles are in consecutive store slots from first, x * size + z
+void BuildClothSprings(SpringTopology &springs, int size, float spacing, uint32_t first)
+{
+	//slot of the particle at the given cartesian coordinates
+	auto particleSlot = [size, first](int x, int z) { return first + static_cast<uint32_t>(x * size + z); };
+	//clearing the list of springs, in case the cloth is built again
+	springs.Clear();
+
+	//looping through x and z axis
+	for (int x = 0; x < size; x++)
+	{
+		for (int z = 0; z < size; z++)
+		{
+			//*********Structural (horizontal and vertical) and Shear (diagonal) springs*********//
+
+			//if the particle is at a margin of the z axis
+			if (z == (size - 1))
+			{
+				//if x + 1 is different from the maximum number allowed (size number)
+				if (x + 1 != size)
+				{
+					//create only horizontal structural spring
+					//get the current particle and link it to the next one, using the appropriate spring class
+					springs.Add(particleSlot(x + 1, z), particleSlot(x, z), spacing, SPRING_STRETCH);
+				}
+			}
+			//if the particle is at a margin of the x axis
+			else if (x == (size - 1))
+			{
+				//if z + 1 is different from the maximum number allowed (size number)
+				if (z + 1 != size)
+				{
+					//vertical structural spring
+					//get the current particle and link it to the next one, using the appropriate spring class
+					springs.Add(particleSlot(x, z + 1), particleSlot(x, z), spacing, SPRING_STRETCH);
+				}
+			}
+			//if z + 1 and x + 1 are different from the maximum number allowed (size number)
+			else if (x != (size - 1) && z != (size - 1))
+			{
+				//then every type of spring can be created..
+
+				//creating diagonal shear spring
+				//get the current particle and link it to the next one. Since it is diagonal, to keep the same distance, the natural length of the spring
+				//is set to the diagonal of the square created by the 4 particles where the current particle is
+				springs.Add(particleSlot(x + 1, z + 1), particleSlot(x, z), (spacing * sqrtf(2.0f)), SPRING_SHEAR);
+				//vertical structural spring
+				springs.Add(particleSlot(x, z + 1), particleSlot(x, z), spacing, SPRING_STRETCH);
+				//horizontal structural spring
+				springs.Add(particleSlot(x + 1, z), particleSlot(x, z), spacing, SPRING_STRETCH);
+			}
+			//if x is more than 0 and z is less than the last row
+			if (x > 0 && z < (size - 1))
+			{
+			//create reverse diagonal shear spring
+			springs.Add(particleSlot(x - 1, z + 1), particleSlot(x, z), (spacing * sqrtf(2.0f)), SPRING_SHEAR);
+			}
+
+			//Bending springs (vertical, horizontal and diagonal springs every two particle)
+
+			//if z + 2 doesn't go outside the cloth
+				if (z + 2 < size)
+				{
+					//vertical bending spring
+					springs.Add(particleSlot(x, z + 2), particleSlot(x, z), spacing * 2, SPRING_BEND);
+				}
+				//if x + 2 doesn't go outside the cloth
+				if (x + 2 < size)
+				{
+					//horizontal bending spring
+					springs.Add(particleSlot(x + 2, z), particleSlot(x, z), spacing * 2.0f, SPRING_BEND);
+				}
+				//check if both x + 2 and z + 2 don't go outside the cloth
+				if (x + 2 < size && z + 2 < size)
+				{
+					//diagonal bending spring, using diagonal of the square of paricles, multiplied by 2 since bending spring is created every 2 particle
+					springs.Add(particleSlot(x + 2, z + 2), particleSlot(x, z), (spacing * sqrtf(2.0f)) * 2, SPRING_DIAGONAL_BEND);
+				}
+				//check if both x - 2 and z + 2 don't go outside the cloth
+				if (x - 2 >= 0 && z + 2 < size)
+				{
+					//reverse diagonal bending spring, across two squares like the one above
+					springs.Add(particleSlot(x - 2, z + 2), particleSlot(x, z), (spacing * sqrtf(2.0f)) * 2, SPRING_DIAGONAL_BEND);
+				}
+		}
+	}
+	//sorting the springs in independent groups, so they can be evaluated in parallel
+	ColorSprings(springs);
+}
+
+//Method to copy the spring and damper constants to the physics, called every time they change
+static void syncSpringParams()
+{
+	clothParams.stiffness[SPRING_STRETCH] = stretchConstant;
+	clothParams.stiffness[SPRING_SHEAR] = shearConstant;
+	clothParams.stiffness[SPRING_BEND] = bendingConstant;
+	clothParams.stiffness[SPRING_DIAGONAL_BEND] = diagonalBendingConstant;
+	clothParams.damping = dampingFactor;
+}
+
+//Method to generate the cloth, creating particles and putting them in a grid layout nad inserting them into the list of particles
+void Cloth()
+{
+	//getting rid of a previous cloth and reserving room for every particle at once, and for the renderer the demo adds
+	destroyCloth();
+	clothPool.Reserve(rows * rows, 1);
+	ClothParticles.reserve(rows * rows);
+	//looping through x axis
+	for (int x = 0; x < rows; x++)
+	{
+		//looping through z axys
+		for (int z = 0; z < rows; z++)
+		{
+			//creating particle in the pool based on x and z value (using a distance of 0.3), with collider radius 0.03
+			ParticlePool::Handle particle = clothPool.Add(vec3(x*0.3f, 10.0f, (z - 10.0f)*0.3f), 1.0f, 0.03f);
+			//pushing it into the vector containing all particles
+			ClothParticles.push_back(clothPool.GetEntity(particle));
+		}
+	}
+	//creating the springs once, the physics evaluates them every tick
+	BuildClothSprings(clothSprings, rows, naturalLength, static_cast<uint32_t>(getParticle(0, 0)->index));
+	syncSpringParams();
+	SetSprings(&clothSprings, &clothParams);
+	//the implicit solver can coarsen the grid for multigrid
+	SetSolverGrid(static_cast<uint32_t>(getParticle(0, 0)->index), rows);
+	//self collision over the same particles, skipping the pairs joined by a spring
+	clothSelfCollision.Init(clothSprings, static_cast<uint32_t>(getParticle(0, 0)->index), rows * rows, clothThickness);
+	SetSelfCollision(&clothSelfCollision);
+	//tiles of 8x8 particles go to sleep once they have hung still for a second
+	clothSleep.Init(static_cast<uint32_t>(getParticle(0, 0)->index), rows);
+	SetSleep(&clothSleep);
+}
+
+//Method to destroy the cloth, all the particles are freed together by the pool
+void destroyCloth()
+{
+	//the physics must not look at the particles anymore
+	SetSprings(nullptr, nullptr);
+	SetSolverGrid(0, 0);
+	SetSelfCollision(nullptr);
+	SetSleep(nullptr);
+	ClothParticles.clear();
+	clothPool.Release();
+}
+
+//Method to generate the wind in a given direction
+void generateWind(const vec3 direction)
+{
+	//calculate wind for every particle
+	for (auto &e : ClothParticles) {
+		//add a randomness to every particle to make wind more realistic (multiplied by 4)
+		float random = ((float)rand() / RAND_MAX) * 4.0f;
+		//getting the cPhysics of the particle (to get particles attributes)
+		auto p = e->getComponent<cPhysics>();
+		//windforce is the wind direction by the random factor
+		vec3 windForce = direction  * random;
+		//adding wind to particle as a force
+		p->AddImpulse(windForce);
+	}
+}
+
+//for testing - Fixes top row of the cloth, setting those particles position to their previous (starting) position and make them fixed, setting the bool to true
+void fixTopRow()
+{
+	//Starting from (0, 4) position
+	int z = rows - 1;
+	int x = 0;
+	//loops the particle position until the row is finished
+	while (x < rows)
+	{
+		//set particle position to prev position
+		getParticle(x, z)->SetPosition(getParticle(x, z)->GetPrevPosition());
+		//set bool to true, so the particles are not rendered anymore
+		getParticle(x, z)->SetFixed(true);
+		//increment x axis
+		x++;
+	}
+}
+
+//for testing - Fixes bottom row of the cloth, setting those particles position to their previous (starting) position and make them fixed, setting the bool to true
+void fixBottomRow()
+{
+	//Starting from (0, 0) position
+	int z = 0;
+	int x = 0;
+	//loops the particle position until the row is finished
+	while (x < rows)
+	{
+		//set particle position to prev position
+		getParticle(x, z)->SetPosition(getParticle(x, z)->GetPrevPosition());
+		//set bool to true, so the particles are not rendered anymore
+		getParticle(x, z)->SetFixed(true);
+		//increment x axis
+		x++;
+	}
+}
+
+//Method to fix the corners of the cloth - works like fixBottomRow and fixTopRow
+void fixCorners()
+{
+	//get the particle at (0, 0) coordinates and set it to previous position, to make it fixed and to not render itanymore
+	getParticle(0, 0)->SetPosition(getParticle(0, 0)->GetPrevPosition());
+	getParticle(0, 0)->SetFixed(true);
+
+	getParticle(0, rows - 1)->SetPosition(getParticle(0, rows - 1)->GetPrevPosition());
+	getParticle(0, rows - 1)->SetFixed(true);
+
+	getParticle(rows - 1, 0)->SetPosition(getParticle(rows - 1, 0)->GetPrevPosition());
+	getParticle(rows - 1, 0)->SetFixed(true);
+
+	getParticle(rows - 1, rows - 1)->SetPosition(getParticle(rows - 1, rows - 1)->GetPrevPosition());
+	getParticle(rows - 1, rows - 1)->SetFixed(true);
+}
+
+//Method to add mass to every particle in the cloth
+void addMass()
+{
+	//Particle
+	cPhysics *p;
+
+	//for every Entity in ClothParticles
+	for (auto &e : ClothParticles) {
+		//getting the cPhysics of the particle (getting particles attributes)
+		p = e->getComponent<cPhysics>();
+		//checking if mass doesn't go over safe value (30)
+		if (p->GetMass() < 30.0)
+			//increase mass
+			p->SetMass(p->GetMass() + 0.05);
+	}
+
+	//for testing only - can be commented out
+	p = ClothParticles[15]->getComponent<cPhysics>(); //
+	cout << "Cloth mass is: " << p->GetMass();										  //
+}
+
+//Method to remove mass to every particle in the cloth
+void removeMass()
+{
+	//Particle
+	cPhysics *p;
+
+	//for every Entity in ClothParticles
+	for (auto &e : ClothParticles) {
+		//getting the cPhysics of the particle (getting particles attributes)
+		p = e->getComponent<cPhysics>();
+		//checking if mass doesn't go ower than safe value (1)
+		if (p->GetMass() > 1.0)
+			//decrease mass
+			p->SetMass(p->GetMass() - 0.05);
+	}
+
+	//for testing only - can be commented out
+	p = ClothParticles[15]->getComponent<cPhysics>(); //
+	cout << "Cloth mass is: " << p->GetMass();
+}
+
+//Method to increase gravity
+void increaseGravity()
+{
+	//gravity is shared by every particle in the store
+	vec3 &gravity = GetParticles().gravity;
+	//checking if gravity doesn't go over safe value (-40)
+	if (gravity.y > -40.0)
+		//increase gravity (in a negative direction)
+		gravity.y -= 0.1f;
+
+	//for testing only - can be commented out
+	cout << "Gravity is: " << gravity.y;
+}
+
+//Method to decrease gravity
+void decreaseGravity()
+{
+	//gravity is shared by every particle in the store
+	vec3 &gravity = GetParticles().gravity;
+	//checking if gravity doesn't go lower than safe value (-1)
+	if (gravity.y < -1.0)
+		//decrease gravity (in a positive direction)
+		gravity.y += 0.1f;
+
+	//for testing only - can be commented out
+	cout << "Gravity is: " << gravity.y;
+}
+
+//Get stiffness average of the cloth, to show the value to the user
+double getAverageStiffness()
+{
+	//initializing average
+	double average = 0.0;
+	//adding all spring constants to average
+	average += stretchConstant;
+	average += shearConstant;
+	average += bendingConstant;
+	average += diagonalBendingConstant;
+	//dividing the average by 4 (number of spring constants defined)
+	average /= 4.0;
+
+	//return average
+	return average;
+}
+
+//Method to increase stiffness of the cloth, modifing springs constants
+void increaseStiffness()
+{
+	//increment constant of 0.3 only if the highest constant is less than 95.0 (safe value tested)
+	if (stretchConstant < 95.0f)
+	{
+		//incrementing constants and damping factor
+		stretchConstant += 0.3f;
+		shearConstant += 0.3f;
+		bendingConstant += 0.3f;
+		diagonalBendingConstant += 0.3f;
+		dampingFactor += 0.3f;
+	}
+	else if (stretchConstant < 97.0 && stretchConstant > 93.0f)
+	{
+		stretchConstant = 95.0f;
+		shearConstant = 90.0f;
+		bendingConstant = 80.0f;
+		diagonalBendingConstant = 20.0f;
+		dampingFactor = 90.0f;
+	}
+	syncSpringParams();
+}
+
+//Method to decrease stiffness of the cloth, modifing springs constants
+void decreaseStiffness()
+{
+	//checking that every spring constand and damper doesn't go lower than  agiven safe value
+
+	if (diagonalBendingConstant > 1.0f)
+	{
+		//decreasing the spring constant if not lower than 1
+		diagonalBendingConstant -= 0.3f;
+	}
+	if (stretchConstant > 20.0f)
+	{
+		//decreasing the spring constant if not lower than 20
+		stretchConstant -= 0.3f;
+		//damping factos should ideally be really similar to stretch constrant
+		dampingFactor -= 0.3f;
+	}
+	if (stretchConstant > 20.0f)
+	{
+		shearConstant -= 0.3f;
+	}
+	if (bendingConstant > 20.0f)
+	{
+		bendingConstant -= 0.3f;
+	}
+	syncSpringParams();
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "particlepool.h"
+#include "physics.h"
+#include "selfcollision.h"
+#include "sleep.h"
+#include "springs.h"
+#include <memory>
+#include <vector>
+
+//Cloth builder and cloth parameters, shared by the graphical demo and the headless driver.
+//Nothing in here touches GL/GLFW, rendering components are attached by the application.
+
+//Vectors containing particles and springs of the cloth, the particles live in clothPool
+extern std::vector<Entity *> ClothParticles;
+extern ParticlePool clothPool;
+extern SpringTopology clothSprings;
+//keeps the cloth from passing through itself when it folds
+extern SelfCollision clothSelfCollision;
+//parts of the cloth that have come to rest, skipped by the physics until something moves them
+extern SleepTiles clothSleep;
+
+//cloth is composed of rows x rows particles
+extern int rows;
+//Springs and damper constants
+extern float stretchConstant;
+extern float shearConstant;
+extern float bendingConstant;
+extern float diagonalBendingConstant;
+extern float dampingFactor;
+//natural length of the cloth set to distance between particles
+extern float naturalLength;
+//minimum distance between particles not joined by a spring
+extern float clothThickness;
+
+//method to create the cloth particles at a given position and with a given mass
+std::unique_ptr<Entity> CreateParticle(float xPos, float yPos, float zPos, double myMass);
+//Method to get specific particle in the list of Cloth Particles, based on its cartesian coordinates
+cPhysics *getParticle(int x, int z);
+//Method to generate the cloth, creating particles in a grid layout and the springs between them
+void Cloth();
+//Method to destroy the cloth, releasing every particle at once
+void destroyCloth();
+//Method to create the springs of a size x size cloth whose particles are in consecutive store slots from first, x * size + z
+void BuildClothSprings(SpringTopology &springs, int size, float spacing, uint32_t first);
+//Method to generate the wind in a given direction
+void generateWind(const glm::vec3 direction);
+
+//Methods to fix parts of the cloth in place
+void fixTopRow();
+void fixBottomRow();
+void fixCorners();
+
+//Methods to change the cloth parameters, clamped to the tested safe values
+void addMass();
+void removeMass();
+void increaseGravity();
+void decreaseGravity();
+double getAverageStiffness();
+void increaseStiffness();
+void decreaseStiffness();
@@ -0,0 +1,221 @@
+#include "clothmesh.h"
+#include "simd.h"
+#include <cmath>
+
+using namespace std;
+
+ClothMesh::ClothMesh() : rows_(0), version_(0), previous_(nullptr), current_(nullptr), count_(0), alpha_(1.0f) {
+  ResetStats();
+}
+
+void ClothMesh::ResetStats() {
+  stats_.indexBuilds = 0;
+  stats_.indexBytes = 0;
+  stats_.packs = 0;
+  stats_.vertexBytes = 0;
+  stats_.allocations = 0;
+}
+
+void ClothMesh::SetGrid(size_t rows, const uint32_t *slots) {
+  const size_t vertices = rows * rows;
+  const size_t cells = rows > 1 ? (rows - 1) * (rows - 1) : 0;
+  const size_t capacity = slots_.capacity() + x_.capacity() + ax_.capacity();
+  slots_.resize(vertices);
+  for (size_t i = 0; i < vertices; ++i) {
+    slots_[i] = slots ? slots[i] : static_cast<uint32_t>(i);
+  }
+  for (auto v : {&x_, &y_, &z_}) {
+    v->resize(vertices);
+  }
+  for (auto v : {&ax_, &ay_, &az_, &bx_, &by_, &bz_}) {
+    v->resize(cells);
+  }
+  stats_.allocations += slots_.capacity() + x_.capacity() + ax_.capacity() != capacity;
+  // the triangles only depend on the grid size
+  if (rows == rows_ && !indices_.empty()) {
+    return;
+  }
+  rows_ = rows;
+  const size_t indexCapacity = indices_.capacity();
+  phys::BuildGridIndices(rows_, indices_);
+  stats_.allocations += indices_.capacity() != indexCapacity;
+  ++version_;
+  ++stats_.indexBuilds;
+  stats_.indexBytes += indices_.size() * sizeof(uint32_t);
+}
+
+void ClothMesh::SetPositions(const glm::vec3 *previous, const glm::vec3 *current, size_t count, float alpha) {
+  previous_ = previous;
+  current_ = current;
+  count_ = current ? count : 0;
+  alpha_ = alpha;
+}
+
+const uint32_t *ClothMesh::Indices(size_t &count, uint32_t &version) const {
+  count = indices_.size();
+  version = version_;
+  return indices_.data();
+}
+
+void ClothMesh::InterpolateRows(size_t begin, size_t end) {
+  for (size_t i = begin * rows_; i < end * rows_; ++i) {
+    const uint32_t s = slots_[i];
+    glm::vec3 p(0.0f);
+    // slots the positions don't cover yet (a snapshot from before the cloth was built) sit at the origin
+    if (s < count_) {
+      p = previous_ ? previous_[s] + (current_[s] - previous_[s]) * alpha_ : current_[s];
+    }
+    x_[i] = p.x;
+    y_[i] = p.y;
+    z_[i] = p.z;
+  }
+}
+
+void ClothMesh::FaceNormalRows(size_t begin, size_t end) {
+  // cell (x, y) has corners i = x * rows + y, i + 1, i + rows and i + rows + 1, and the triangles (i, i + 1,
+  // i + rows + 1) and (i, i + rows + 1, i + rows); their cross products are the normals scaled by twice the area
+  const size_t r = rows_;
+  const size_t w = r - 1;
+  for (size_t x = begin; x < end; ++x) {
+    size_t y = 0;
+#ifdef PHYS_X86
+    for (; y + 4 <= w; y += 4) {
+      const size_t i = x * r + y;
+      const size_t c = x * w + y;
+      const __m128 x0 = _mm_loadu_ps(&x_[i]), y0 = _mm_loadu_ps(&y_[i]), z0 = _mm_loadu_ps(&z_[i]);
+      // edges from corner i to i + 1, i + rows + 1 and i + rows
+      const __m128 ex1 = _mm_sub_ps(_mm_loadu_ps(&x_[i + 1]), x0);
+      const __m128 ey1 = _mm_sub_ps(_mm_loadu_ps(&y_[i + 1]), y0);
+      const __m128 ez1 = _mm_sub_ps(_mm_loadu_ps(&z_[i + 1]), z0);
+      const __m128 ex2 = _mm_sub_ps(_mm_loadu_ps(&x_[i + r + 1]), x0);
+      const __m128 ey2 = _mm_sub_ps(_mm_loadu_ps(&y_[i + r + 1]), y0);
+      const __m128 ez2 = _mm_sub_ps(_mm_loadu_ps(&z_[i + r + 1]), z0);
+      const __m128 ex3 = _mm_sub_ps(_mm_loadu_ps(&x_[i + r]), x0);
+      const __m128 ey3 = _mm_sub_ps(_mm_loadu_ps(&y_[i + r]), y0);
+      const __m128 ez3 = _mm_sub_ps(_mm_loadu_ps(&z_[i + r]), z0);
+      _mm_storeu_ps(&ax_[c], _mm_sub_ps(_mm_mul_ps(ey1, ez2), _mm_mul_ps(ez1, ey2)));
+      _mm_storeu_ps(&ay_[c], _mm_sub_ps(_mm_mul_ps(ez1, ex2), _mm_mul_ps(ex1, ez2)));
+      _mm_storeu_ps(&az_[c], _mm_sub_ps(_mm_mul_ps(ex1, ey2), _mm_mul_ps(ey1, ex2)));
+      _mm_storeu_ps(&bx_[c], _mm_sub_ps(_mm_mul_ps(ey2, ez3), _mm_mul_ps(ez2, ey3)));
+      _mm_storeu_ps(&by_[c], _mm_sub_ps(_mm_mul_ps(ez2, ex3), _mm_mul_ps(ex2, ez3)));
+      _mm_storeu_ps(&bz_[c], _mm_sub_ps(_mm_mul_ps(ex2, ey3), _mm_mul_ps(ey2, ex3)));
+    }
+#endif
+    for (; y < w; ++y) {
+      const size_t i = x * r + y;
+      const size_t c = x * w + y;
+      const glm::vec3 p0(x_[i], y_[i], z_[i]);
+      const glm::vec3 e1 = glm::vec3(x_[i + 1], y_[i + 1], z_[i + 1]) - p0;
+      const glm::vec3 e2 = glm::vec3(x_[i + r + 1], y_[i + r + 1], z_[i + r + 1]) - p0;
+      const glm::vec3 e3 = glm::vec3(x_[i + r], y_[i + r], z_[i + r]) - p0;
+      ax_[c] = e1.y * e2.z - e1.z * e2.y;
+      ay_[c] = e1.z * e2.x - e1.x * e2.z;
+      az_[c] = e1.x * e2.y - e1.y * e2.x;
+      bx_[c] = e2.y * e3.z - e2.z * e3.y;
+      by_[c] = e2.z * e3.x - e2.x * e3.z;
+      bz_[c] = e2.x * e3.y - e2.y * e3.x;
+    }
+  }
+}
+
+glm::vec3 ClothMesh::VertexNormal(size_t x, size_t y) const {
+  // the vertex is a corner of both triangles of cell (x, y) and (x - 1, y - 1), of the first one of (x, y - 1) and
+  // of the second one of (x - 1, y); cells off the grid are skipped. Same order of sums as the SSE loop.
+  const size_t w = rows_ - 1;
+  float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+  if (x < w && y < w) {
+    const size_t c = x * w + y;
+    sx = ax_[c] + bx_[c];
+    sy = ay_[c] + by_[c];
+    sz = az_[c] + bz_[c];
+  }
+  if (x < w && y > 0) {
+    const size_t c = x * w + y - 1;
+    sx += ax_[c];
+    sy += ay_[c];
+    sz += az_[c];
+  }
+  if (x > 0 && y < w) {
+    const size_t c = (x - 1) * w + y;
+    sx += bx_[c];
+    sy += by_[c];
+    sz += bz_[c];
+  }
+  if (x > 0 && y > 0) {
+    const size_t c = (x - 1) * w + y - 1;
+    sx += ax_[c];
+    sy += ay_[c];
+    sz += az_[c];
+    sx += bx_[c];
+    sy += by_[c];
+    sz += bz_[c];
+  }
+  const float length = sqrtf(sx * sx + sy * sy + sz * sz);
+  // a collapsed neighbourhood has no direction, face up
+  if (!(length > 0.0f)) {
+    return glm::vec3(0.0f, 1.0f, 0.0f);
+  }
+  return glm::vec3(sx / length, sy / length, sz / length);
+}
+
+void ClothMesh::VertexNormalRows(size_t begin, size_t end, ClothVertex *out) const {
+  const size_t r = rows_;
+  const size_t w = r - 1;
+  for (size_t x = begin; x < end; ++x) {
+    size_t y = 0;
+    // the edge rows and columns miss some of their cells, they go through VertexNormal
+    const bool inner = x > 0 && x < w;
+    out[x * r].position = glm::vec3(x_[x * r], y_[x * r], z_[x * r]);
+    out[x * r].normal = VertexNormal(x, 0);
+    y = 1;
+#ifdef PHYS_X86
+    for (; inner && y + 4 <= w; y += 4) {
+      const size_t c = x * w + y;
+      const size_t up = c - w - 1;
+      __m128 sx = _mm_add_ps(_mm_loadu_ps(&ax_[c]), _mm_loadu_ps(&bx_[c]));
+      __m128 sy = _mm_add_ps(_mm_loadu_ps(&ay_[c]), _mm_loadu_ps(&by_[c]));
+      __m128 sz = _mm_add_ps(_mm_loadu_ps(&az_[c]), _mm_loadu_ps(&bz_[c]));
+      sx = _mm_add_ps(sx, _mm_loadu_ps(&ax_[c - 1]));
+      sy = _mm_add_ps(sy, _mm_loadu_ps(&ay_[c - 1]));
+      sz = _mm_add_ps(sz, _mm_loadu_ps(&az_[c - 1]));
+      sx = _mm_add_ps(sx, _mm_loadu_ps(&bx_[c - w]));
+      sy = _mm_add_ps(sy, _mm_loadu_ps(&by_[c - w]));
+      sz = _mm_add_ps(sz, _mm_loadu_ps(&bz_[c - w]));
+      sx = _mm_add_ps(_mm_add_ps(sx, _mm_loadu_ps(&ax_[up])), _mm_loadu_ps(&bx_[up]));
+      sy = _mm_add_ps(_mm_add_ps(sy, _mm_loadu_ps(&ay_[up])), _mm_loadu_ps(&by_[up]));
+      sz = _mm_add_ps(_mm_add_ps(sz, _mm_loadu_ps(&az_[up])), _mm_loadu_ps(&bz_[up]));
+      const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy)), _mm_mul_ps(sz, sz)));
+      float nx[4], ny[4], nz[4], len[4];
+      _mm_storeu_ps(nx, _mm_div_ps(sx, length));
+      _mm_storeu_ps(ny, _mm_div_ps(sy, length));
+      _mm_storeu_ps(nz, _mm_div_ps(sz, length));
+      _mm_storeu_ps(len, length);
+      for (int lane = 0; lane < 4; ++lane) {
+        const size_t i = x * r + y + lane;
+        out[i].position = glm::vec3(x_[i], y_[i], z_[i]);
+        out[i].normal = len[lane] > 0.0f ? glm::vec3(nx[lane], ny[lane], nz[lane]) : glm::vec3(0.0f, 1.0f, 0.0f);
+      }
+    }
+#endif
+    for (; y < r; ++y) {
+      const size_t i = x * r + y;
+      out[i].position = glm::vec3(x_[i], y_[i], z_[i]);
+      out[i].normal = VertexNormal(x, y);
+    }
+  }
+}
+
+void ClothMesh::Pack(void *dst) {
+  ClothVertex *out = static_cast<ClothVertex *>(dst);
+  const size_t r = rows_;
+  if (!r) {
+    return;
+  }
+  // every pass reads what the one before wrote around it. All three run here on the render thread: the job pool
+  // belongs to the simulation, and a cloth of a few thousand vertices packs faster than the jobs would hand off.
+  InterpolateRows(0, r);
+  FaceNormalRows(0, r - 1);
+  VertexNormalRows(0, r, out);
+  ++stats_.packs;
+  stats_.vertexBytes += r * r * sizeof(ClothVertex);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "phys_utils.h"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+//one vertex of the streamed cloth mesh
+struct ClothVertex {
+  glm::vec3 position;
+  //unit normal, the sum of the normals of the triangles around the vertex weighted by their area
+  glm::vec3 normal;
+};
+
+//what the mesh has cost since its stats were last reset
+struct ClothMeshStats {
+  //index lists built and their size, one per grid size
+  uint64_t indexBuilds;
+  uint64_t indexBytes;
+  //frames packed and the vertex bytes written for them
+  uint64_t packs;
+  uint64_t vertexBytes;
+  //times one of the mesh's own arrays had to grow
+  uint64_t allocations;
+};
+
+//Render resource of the cloth: the triangle list is built once per grid size, and every frame the particle
+//positions are written straight from the simulation's arrays into the streamed vertex buffer, with no copy in between.
+//Normals are recomputed on every pack: positions, then the two triangle normals of every cell, then the sum around
+//every vertex, each pass 4 columns at a time with SSE. Packing runs on the calling (render) thread and never touches
+//the job pool, so it can't hold up the simulation ticking on another thread.
+class ClothMesh : public phys::GridSource {
+public:
+  ClothMesh();
+  //rows x rows grid, vertex i is particle store slot slots[i] (slot i when slots is null)
+  void SetGrid(size_t rows, const uint32_t *slots = nullptr);
+  //positions of the next pack, by store slot, count slots each: previous and current tick, interpolated by alpha.
+  //previous may be null. The arrays must stay alive until the mesh is packed.
+  void SetPositions(const glm::vec3 *previous, const glm::vec3 *current, size_t count, float alpha);
+
+  size_t Rows() const { return rows_; }
+  size_t Stride() const { return sizeof(ClothVertex); }
+  size_t NormalOffset() const { return offsetof(ClothVertex, normal); }
+  const uint32_t *Indices(size_t &count, uint32_t &version) const;
+  void Pack(void *dst);
+
+  const ClothMeshStats &Stats() const { return stats_; }
+  void ResetStats();
+
+private:
+  void InterpolateRows(size_t begin, size_t end);
+  void FaceNormalRows(size_t begin, size_t end);
+  void VertexNormalRows(size_t begin, size_t end, ClothVertex *out) const;
+  glm::vec3 VertexNormal(size_t x, size_t y) const;
+
+  size_t rows_;
+  uint32_t version_;
+  std::vector<uint32_t> indices_;
+  //store slot of every vertex
+  std::vector<uint32_t> slots_;
+  const glm::vec3 *previous_;
+  const glm::vec3 *current_;
+  size_t count_;
+  float alpha_;
+  //positions being packed, by vertex
+  std::vector<float> x_, y_, z_;
+  //normals (not normalised) of the two triangles of every cell, (rows - 1) x (rows - 1)
+  std::vector<float> ax_, ay_, az_, bx_, by_, bz_;
+  ClothMeshStats stats_;
+};
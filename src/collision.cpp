@@ -1,4 +1,5 @@
 #include "collision.h"
+#include <algorithm>
 #include <glm/glm.hpp>
 
 using namespace std;
@@ -6,85 +7,102 @@ using namespace glm;
 namespace collision {
 
 bool IsColliding(const cSphereCollider &c1, const cSphereCollider &c2, dvec3 &pos, dvec3 &norm, double &depth) {
-  const dvec3 p1 = c1.GetParent()->GetPosition();
-  const dvec3 p2 = c2.GetParent()->GetPosition();
-  const dvec3 d = p2 - p1;
-  const double distance = glm::length(d);
-  const double sumRadius = c1.radius + c2.radius;
-  if (distance < sumRadius) {
-    depth = sumRadius - distance;
-    norm = -glm::normalize(d);
-    pos = p1 - norm * (c1.radius - depth * 0.5f);
-    return true;
+  const vec3 p1 = c1.GetParent()->GetPosition();
+  vec3 n;
+  float d;
+  // same test as the batched pairs
+  if (!SpherePairContact(p1, float(c1.radius), c2.GetParent()->GetPosition(), float(c2.radius), n, d)) {
+    return false;
   }
-  return false;
+  norm = dvec3(n);
+  depth = d;
+  pos = dvec3(p1) - norm * (c1.radius - depth * 0.5);
+  return true;
 }
 
 bool IsColliding(const cSphereCollider &s, const cPlaneCollider &p, dvec3 &pos, dvec3 &norm, double &depth) {
-  const dvec3 sp = s.GetParent()->GetPosition();
-  const dvec3 pp = p.GetParent()->GetPosition();
-
-  // Calculate a vector from a point on the plane to the center of the sphere
-  const dvec3 vecTemp(sp - pp);
+  const vec3 sp = s.GetParent()->GetPosition();
+  float d;
+  // same test as the batched spheres against a plane
+  if (!SpherePlaneContact(sp.x, sp.y, sp.z, float(s.radius), p.GetParent()->GetPosition(), vec3(p.normal), d)) {
+    return false;
+  }
+  norm = p.normal;
+  depth = d;
+  pos = dvec3(sp) - norm * (s.radius - depth);
+  return true;
+}
 
-  // Calculate the distance: dot product of the new vector with the plane's normal
-  double distance = dot(vecTemp, p.normal);
+bool IsColliding(const cPlaneCollider &c1, const cPlaneCollider &c2, dvec3 &pos, dvec3 &norm, double &depth) {
+  // planes never collide with each other
+  return false;
+}
 
-  if (distance <= s.radius) {
-    norm = p.normal;
-    pos = sp - norm * distance;
-    depth = s.radius - distance;
+// plane first: same test as sphere first, with the normal flipped so it still points from c2 to c1
+static bool IsColliding(const cPlaneCollider &p, const cSphereCollider &s, dvec3 &pos, dvec3 &norm, double &depth) {
+  if (IsColliding(s, p, pos, norm, depth)) {
+    norm = -norm;
     return true;
   }
-
   return false;
 }
 
-bool IsColliding(const cPlaneCollider &c1, const cPlaneCollider &c2, dvec3 &pos, dvec3 &norm, double &depth) {
-  cout << "PLANE PLANE" << endl;
-  return false;
+// casts are safe, the table below is indexed by the shape tags
+template <typename A, typename B>
+static bool Dispatch(const cCollider &c1, const cCollider &c2, dvec3 &pos, dvec3 &norm, double &depth) {
+  return IsColliding(static_cast<const A &>(c1), static_cast<const B &>(c2), pos, norm, depth);
 }
 
+typedef bool (*CollideFn)(const cCollider &, const cCollider &, dvec3 &, dvec3 &, double &);
+static const CollideFn table[SHAPE_COUNT][SHAPE_COUNT] = {
+    {Dispatch<cSphereCollider, cSphereCollider>, Dispatch<cSphereCollider, cPlaneCollider>},
+    {Dispatch<cPlaneCollider, cSphereCollider>, Dispatch<cPlaneCollider, cPlaneCollider>},
+};
+
 bool IsColliding(const cCollider &c1, const cCollider &c2, glm::dvec3 &pos, glm::dvec3 &norm, double &depth) {
-  enum shape {
-    UNKOWN = 0,
-    PLANE,
-    SPHERE,
-  };
-  shape s1 = UNKOWN;
-  shape s2 = UNKOWN;
-  if (dynamic_cast<const cSphereCollider *>(&c1)) {
-    s1 = SPHERE;
-  } else if (dynamic_cast<const cPlaneCollider *>(&c1)) {
-    s1 = PLANE;
-  }
+  return table[c1.shape][c2.shape](c1, c2, pos, norm, depth);
+}
 
-  if (dynamic_cast<const cSphereCollider *>(&c2)) {
-    s2 = SPHERE;
-  } else if (dynamic_cast<const cPlaneCollider *>(&c2)) {
-    s2 = PLANE;
-  }
+// the batched combinations: sphere pairs in jobs of pairs, spheres against each plane in jobs of spheres
+static size_t SpherePairJobs(const ShapeBatch &b, size_t grain) { return JobPool::Chunks(b.pairCount, grain); }
 
-  if (!s1 || !s2) {
-    cout << "Routing Error" << endl;
-    return false;
-  }
-  if (s1 == PLANE) {
-    if (s2 == PLANE) {
-      return IsColliding(dynamic_cast<const cPlaneCollider &>(c1), dynamic_cast<const cPlaneCollider &>(c2), pos, norm,
-                         depth);
-    } else {
-      return IsColliding(dynamic_cast<const cPlaneCollider &>(c1), dynamic_cast<const cSphereCollider &>(c2), pos, norm,
-                         depth);
-    }
-  } else {
-    if (s2 == PLANE) {
-      return IsColliding(dynamic_cast<const cSphereCollider &>(c1), dynamic_cast<const cPlaneCollider &>(c2), pos, norm,
-                         depth);
-    } else {
-      return IsColliding(dynamic_cast<const cSphereCollider &>(c1), dynamic_cast<const cSphereCollider &>(c2), pos,
-                         norm, depth);
-    }
-  }
+static void SpherePairBatch(const ShapeBatch &b, size_t k, size_t grain, ContactBuffer &out) {
+  const size_t first = k * grain;
+  CollideSpherePairs(*b.spheres, b.pairs + first, std::min(grain, b.pairCount - first), out);
+}
+
+static size_t SpherePlaneJobs(const ShapeBatch &b, size_t grain) {
+  return JobPool::Chunks(b.spheres->Size(), grain) * b.planeCount;
+}
+
+static void SpherePlaneBatch(const ShapeBatch &b, size_t k, size_t grain, ContactBuffer &out) {
+  const size_t sphereJobs = JobPool::Chunks(b.spheres->Size(), grain);
+  const cPlaneCollider *plane = b.planes[k / sphereJobs];
+  const size_t first = k % sphereJobs * grain;
+  CollideSpheresPlane(*b.spheres, plane->GetParent()->GetPosition(), vec3(plane->normal), first,
+                      std::min(first + grain, b.spheres->Size()), out);
+}
+
+// planes never touch, and planes against spheres are the spheres against planes
+static size_t NoJobs(const ShapeBatch &, size_t) { return 0; }
+
+static void NoBatch(const ShapeBatch &, size_t, size_t, ContactBuffer &) {}
+
+struct BatchFns {
+  size_t (*jobs)(const ShapeBatch &, size_t);
+  void (*run)(const ShapeBatch &, size_t, size_t, ContactBuffer &);
+};
+static const BatchFns batches[SHAPE_COUNT][SHAPE_COUNT] = {
+    {{SpherePairJobs, SpherePairBatch}, {SpherePlaneJobs, SpherePlaneBatch}},
+    {{NoJobs, NoBatch}, {NoJobs, NoBatch}},
+};
+
+size_t BatchJobs(ColliderShape a, ColliderShape b, const ShapeBatch &batch, size_t grain) {
+  return batches[a][b].jobs(batch, grain);
+}
+
+void CollideBatch(ColliderShape a, ColliderShape b, const ShapeBatch &batch, size_t k, size_t grain,
+                  ContactBuffer &out) {
+  batches[a][b].run(batch, k, grain, out);
+}
 }
-}
\ No newline at end of file
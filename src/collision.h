@@ -1,9 +1,30 @@
 #pragma once
+#include "broadphase.h"
 #include "game.h"
+#include "narrowphase.h"
 #include "physics.h"
 #include <glm/vec3.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 
 namespace collision {
+//any two colliders, dispatched on their shape tags
 bool IsColliding(const cCollider &c1, const cCollider &c2, glm::dvec3 &pos, glm::dvec3 &norm, double &depth);
+bool IsColliding(const cSphereCollider &c1, const cSphereCollider &c2, glm::dvec3 &pos, glm::dvec3 &norm, double &depth);
+bool IsColliding(const cSphereCollider &s, const cPlaneCollider &p, glm::dvec3 &pos, glm::dvec3 &norm, double &depth);
+bool IsColliding(const cPlaneCollider &c1, const cPlaneCollider &c2, glm::dvec3 &pos, glm::dvec3 &norm, double &depth);
+
+//A tick's colliders as the batched tests see them: the spheres as SoA with the candidate pairs the broadphase found
+//among them, and the planes. Each shape combination runs as jobs of up to grain tests, every job one tight loop of
+//the same test, dispatched through the same shape table as IsColliding.
+struct ShapeBatch {
+  const SphereSet *spheres;
+  const SpherePair *pairs;
+  size_t pairCount;
+  cPlaneCollider *const *planes;
+  size_t planeCount;
+};
+//jobs of shape combination a x b, 0 for combinations that never touch or are batched the other way round
+size_t BatchJobs(ColliderShape a, ColliderShape b, const ShapeBatch &batch, size_t grain);
+//runs job k of combination a x b, appending its contacts to out
+void CollideBatch(ColliderShape a, ColliderShape b, const ShapeBatch &batch, size_t k, size_t grain, ContactBuffer &out);
 }
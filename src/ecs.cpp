@@ -0,0 +1,170 @@
+#include "ecs.h"
+#include <cassert>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <typeindex>
+
+using namespace std;
+
+uint32_t ComponentTypeId(const type_info &type) {
+  static unordered_map<type_index, uint32_t> ids;
+  // first use of a type can come from any thread, each type only takes the lock once
+  static mutex idsMutex;
+  lock_guard<mutex> lock(idsMutex);
+  auto found = ids.find(type_index(type));
+  if (found != ids.end()) {
+    return found->second;
+  }
+  // a new type gets the next free id
+  const uint32_t id = static_cast<uint32_t>(ids.size());
+  ids[type_index(type)] = id;
+  return id;
+}
+
+World::World() : alive_(0) {
+  for (uint32_t t = 0; t < maxTypes; ++t) {
+    typeSize_[t] = 0;
+  }
+  // archetype 0 holds the entities without components
+  ArchetypeFor(0);
+}
+
+uint32_t World::ArchetypeFor(uint64_t mask) {
+  auto found = byMask_.find(mask);
+  if (found != byMask_.end()) {
+    return found->second;
+  }
+  unique_ptr<Archetype> a(new Archetype());
+  a->mask = mask;
+  for (uint32_t t = 0; t < maxTypes; ++t) {
+    a->column[t] = -1;
+    if (mask & (uint64_t(1) << t)) {
+      a->column[t] = static_cast<int8_t>(a->columns.size());
+      Column c;
+      c.type = t;
+      c.size = typeSize_[t];
+      a->columns.push_back(c);
+    }
+  }
+  const uint32_t index = static_cast<uint32_t>(archetypes_.size());
+  archetypes_.push_back(move(a));
+  byMask_[mask] = index;
+  return index;
+}
+
+EntityId World::Create() {
+  EntityId e;
+  if (!free_.empty()) {
+    e.index = free_.back();
+    free_.pop_back();
+  } else {
+    e.index = static_cast<uint32_t>(records_.size());
+    Record r = {0, 0, 0, false};
+    records_.push_back(r);
+  }
+  Record &r = records_[e.index];
+  e.generation = r.generation;
+  r.archetype = 0;
+  r.row = static_cast<uint32_t>(archetypes_[0]->entities.size());
+  r.alive = true;
+  archetypes_[0]->entities.push_back(e);
+  ++alive_;
+  return e;
+}
+
+bool World::Alive(EntityId e) const {
+  return e.index < records_.size() && records_[e.index].alive && records_[e.index].generation == e.generation;
+}
+
+void World::Destroy(EntityId e) {
+  if (!Alive(e)) {
+    return;
+  }
+  Record &r = records_[e.index];
+  RemoveRow(r.archetype, r.row);
+  r.alive = false;
+  // handles to the old entity no longer match the slot
+  ++r.generation;
+  free_.push_back(e.index);
+  --alive_;
+}
+
+void World::RemoveRow(uint32_t archetype, uint32_t row) {
+  Archetype &a = *archetypes_[archetype];
+  const size_t last = a.entities.size() - 1;
+  if (row != last) {
+    // the last entity fills the hole
+    for (auto &c : a.columns) {
+      memcpy(&c.data[row * c.size], &c.data[last * c.size], c.size);
+    }
+    a.entities[row] = a.entities[last];
+    records_[a.entities[row].index].row = row;
+  }
+  a.entities.pop_back();
+  for (auto &c : a.columns) {
+    c.data.resize(last * c.size);
+  }
+}
+
+void World::Move(EntityId e, uint32_t to) {
+  Record &r = records_[e.index];
+  const Archetype &from = *archetypes_[r.archetype];
+  Archetype &dest = *archetypes_[to];
+  const uint32_t row = static_cast<uint32_t>(dest.entities.size());
+  dest.entities.push_back(e);
+  for (auto &c : dest.columns) {
+    c.data.resize(c.data.size() + c.size);
+    const int8_t old = from.column[c.type];
+    if (old >= 0) {
+      memcpy(&c.data[row * c.size], &from.columns[old].data[r.row * c.size], c.size);
+    }
+  }
+  RemoveRow(r.archetype, r.row);
+  r.archetype = to;
+  r.row = row;
+}
+
+void *World::AddRaw(EntityId e, uint32_t type, size_t size, const void *value) {
+  assert(Alive(e));
+  // past maxTypes the type has no bit in the masks and no slot in the arrays, a release build must not go on
+  if (type >= maxTypes) {
+    throw length_error("World: more than 64 component types");
+  }
+  if (typeSize_[type] != 0 && typeSize_[type] != size) {
+    throw invalid_argument("World: component type added with a different size");
+  }
+  typeSize_[type] = size;
+  void *to = GetRaw(e, type);
+  if (!to) {
+    const Record &r = records_[e.index];
+    Move(e, ArchetypeFor(archetypes_[r.archetype]->mask | (uint64_t(1) << type)));
+    to = GetRaw(e, type);
+  }
+  memcpy(to, value, size);
+  return to;
+}
+
+void World::RemoveRaw(EntityId e, uint32_t type) {
+  if (!GetRaw(e, type)) {
+    return;
+  }
+  const Record &r = records_[e.index];
+  Move(e, ArchetypeFor(archetypes_[r.archetype]->mask & ~(uint64_t(1) << type)));
+}
+
+void *World::GetRaw(EntityId e, uint32_t type) const {
+  if (!Alive(e) || type >= maxTypes) {
+    return nullptr;
+  }
+  const Record &r = records_[e.index];
+  const Archetype &a = *archetypes_[r.archetype];
+  const int8_t c = a.column[type];
+  return c < 0 ? nullptr : const_cast<unsigned char *>(&a.columns[c].data[r.row * a.columns[c].size]);
+}
+
+World &GetWorld() {
+  // never destroyed, entities in static containers may outlive any other static
+  static World *world = new World();
+  return *world;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+//Dense id of a component type, used as its column in the world and its bit in an archetype mask.
+//Ids are handed out the first time a type is seen, so they are small and can index an array. Safe from any thread.
+uint32_t ComponentTypeId(const std::type_info &type);
+//id of T, looked up once per type and then just a static read
+template <typename T> uint32_t ComponentTypeId() {
+  static const uint32_t id = ComponentTypeId(typeid(T));
+  return id;
+}
+
+//Handle to an entity of a World, the generation tells a destroyed entity from a newer one in the same slot
+struct EntityId {
+  uint32_t index;
+  uint32_t generation;
+};
+
+//Archetype based entity component system.
+//Entities with the same set of component types share an archetype, which keeps every component type in its own
+//dense array, so systems run over plain arrays. Adding or removing a component moves the entity to the archetype
+//of its new set of types, and leaving an archetype swaps its last entity into the hole: both are O(1) in the number
+//of entities. Components are plain data, moved with memcpy, and pointers to them only last until the next add/remove.
+class World {
+public:
+  //component types one world can tell apart, one bit each in an archetype mask
+  static const uint32_t maxTypes = 64;
+
+  World();
+  EntityId Create();
+  void Destroy(EntityId e);
+  bool Alive(EntityId e) const;
+  //entities alive
+  size_t Size() const { return alive_; }
+
+  template <typename T> T &Add(EntityId e, const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value, "world components are plain data");
+    return *static_cast<T *>(AddRaw(e, ComponentTypeId<T>(), sizeof(T), &value));
+  }
+  template <typename T> void Remove(EntityId e) { RemoveRaw(e, ComponentTypeId<T>()); }
+  //nullptr if the entity has no T
+  template <typename T> T *Get(EntityId e) const { return static_cast<T *>(GetRaw(e, ComponentTypeId<T>())); }
+  template <typename T> bool Has(EntityId e) const { return GetRaw(e, ComponentTypeId<T>()) != nullptr; }
+
+  //fn(count, entities, a) once per archetype holding an A, a is that archetype's dense array of them
+  template <typename A, typename F> void Each(F fn) const { EachRaw<A>(ComponentTypeId<A>(), fn); }
+  //fn(count, entities, a, b) once per archetype holding both an A and a B, the arrays share their rows
+  template <typename A, typename B, typename F> void Each(F fn) const {
+    const uint32_t ta = ComponentTypeId<A>();
+    const uint32_t tb = ComponentTypeId<B>();
+    if (ta >= maxTypes || tb >= maxTypes) {
+      return;
+    }
+    const uint64_t need = (uint64_t(1) << ta) | (uint64_t(1) << tb);
+    for (auto &a : archetypes_) {
+      if ((a->mask & need) == need && !a->entities.empty()) {
+        fn(a->entities.size(), a->entities.data(), static_cast<A *>(a->Data(ta)), static_cast<B *>(a->Data(tb)));
+      }
+    }
+  }
+  //Each for a column whose type id isn't the id of its element type, see Entity
+  template <typename A, typename F> void EachRaw(uint32_t type, F fn) const {
+    if (type >= maxTypes) {
+      return;
+    }
+    const uint64_t need = uint64_t(1) << type;
+    for (auto &a : archetypes_) {
+      if ((a->mask & need) && !a->entities.empty()) {
+        fn(a->entities.size(), a->entities.data(), static_cast<A *>(a->Data(type)));
+      }
+    }
+  }
+
+  //untyped versions, for components whose type is only known at run time. Adding a type the entity already has
+  //overwrites it. Adding a type id past maxTypes throws length_error, or a known type with another size
+  //invalid_argument.
+  void *AddRaw(EntityId e, uint32_t type, size_t size, const void *value);
+  void RemoveRaw(EntityId e, uint32_t type);
+  void *GetRaw(EntityId e, uint32_t type) const;
+
+private:
+  struct Column {
+    uint32_t type;
+    size_t size;
+    std::vector<unsigned char> data;
+  };
+  struct Archetype {
+    uint64_t mask;
+    std::vector<Column> columns;
+    //column of every type in the mask, -1 for the others
+    int8_t column[maxTypes];
+    //entity in every row
+    std::vector<EntityId> entities;
+    void *Data(uint32_t type) const {
+      const int8_t c = column[type];
+      return c < 0 ? nullptr : const_cast<unsigned char *>(columns[c].data.data());
+    }
+  };
+  //where an entity's components live
+  struct Record {
+    uint32_t archetype;
+    uint32_t row;
+    uint32_t generation;
+    bool alive;
+  };
+
+  uint32_t ArchetypeFor(uint64_t mask);
+  //moves the components e keeps to archetype to, new ones are left for the caller to fill
+  void Move(EntityId e, uint32_t to);
+  void RemoveRow(uint32_t archetype, uint32_t row);
+
+  std::vector<std::unique_ptr<Archetype>> archetypes_;
+  std::unordered_map<uint64_t, uint32_t> byMask_;
+  size_t typeSize_[maxTypes];
+  std::vector<Record> records_;
+  //destroyed entity slots, reused by Create
+  std::vector<uint32_t> free_;
+  size_t alive_;
+};
+
+//the world every Entity lives in
+World &GetWorld();
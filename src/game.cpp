@@ -1,11 +1,12 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include "game.h"
 #include <algorithm>
+#include <cassert>
 #include <glm/gtx/transform.hpp>
 
 using namespace glm;
 using namespace std;
-Component::Component(const string &token) {
+Component::Component(const char *token) {
   token_ = token;
   Ent_ = nullptr;
   active_ = false;
@@ -24,6 +25,7 @@ Entity *Component::GetParent() const { return Ent_; }
 //############## Entity ###################
 
 Entity::Entity() {
+  id_ = GetWorld().Create();
   visible_ = true;
   changed_ = true;
   scale_ = vec3(1.0f, 1.0f, 1.0f);
@@ -32,7 +34,7 @@ Entity::Entity() {
   colour = RED;
 }
 
-Entity::~Entity() {}
+Entity::~Entity() { GetWorld().Destroy(id_); }
 
 const vec3 Entity::GetScale() const { return scale_; }
 
@@ -94,17 +96,58 @@ void Entity::Render() {
   }
 }
 
+void ComponentDeleter::operator()(Component *c) const {
+  if (owned) {
+    delete c;
+  } else {
+    c->~Component();
+  }
+}
+
 void Entity::AddComponent(unique_ptr<Component> &c) {
   c->SetParent(this);
-  components_.push_back(move(c));
+  // the first component of a type is the one the world sees
+  const uint32_t type = ComponentTypeId(typeid(*c));
+  if (!GetWorld().GetRaw(id_, type)) {
+    Component *raw = c.get();
+    GetWorld().AddRaw(id_, type, sizeof(raw), &raw);
+  }
+  components_.push_back(ComponentPtr(c.release(), ComponentDeleter(true)));
+}
+
+void Entity::AddComponent(unique_ptr<Component> &&c) { AddComponent(c); }
+
+void Entity::AttachComponent(Component *c) {
+  c->SetParent(this);
+  const uint32_t type = ComponentTypeId(typeid(*c));
+  if (!GetWorld().GetRaw(id_, type)) {
+    GetWorld().AddRaw(id_, type, sizeof(c), &c);
+  }
+  components_.push_back(ComponentPtr(c, ComponentDeleter(false)));
 }
 
+void Entity::ReserveComponents(size_t n) { components_.reserve(n); }
+
 void Entity::RemoveComponent(Component &c) {
   // Todo: Test This
   auto position =
-      find_if(components_.begin(), components_.end(), [c](unique_ptr<Component> &p) { return p.get() == &c; });
+      find_if(components_.begin(), components_.end(), [&c](ComponentPtr &p) { return p.get() == &c; });
   if (position != components_.end()) {
+    const uint32_t type = ComponentTypeId(typeid(c));
+    Component **seen = static_cast<Component **>(GetWorld().GetRaw(id_, type));
+    const bool wasSeen = seen && *seen == &c;
     components_.erase(position);
+    // hand the world's column over to the next component of the same type, if any
+    if (wasSeen) {
+      GetWorld().RemoveRaw(id_, type);
+      for (auto &other : components_) {
+        if (ComponentTypeId(typeid(*other)) == type) {
+          Component *raw = other.get();
+          GetWorld().AddRaw(id_, type, sizeof(raw), &raw);
+          break;
+        }
+      }
+    }
   }
 }
 
@@ -115,36 +158,11 @@ vector<Component *> Entity::GetComponents(string const &name) const {
     return list;
   }
   for (auto &c : components_) {
-    if (c->token_ == name) {
+    if (name == c->token_) {
       list.push_back(c.get()); // It's not like we want to make safe programs anyway...
     }
   }
   return list;
 }
 
-const vector<unique_ptr<Component>> *Entity::GetComponents() const { return &components_; }
-
-//############## Shape Renderer ###################
-
-void cShapeRenderer::SetColour(const phys::RGBAInt32 c) { col_ = c; }
-
-cShapeRenderer::cShapeRenderer(SHAPES s) : shape(s), col_(RED), Component("ShapeRenderer") {}
-
-cShapeRenderer::~cShapeRenderer() {}
-
-void cShapeRenderer::Update(double delta) {}
-
-void cShapeRenderer::Render() {
-  switch (shape) {
-  case SPHERE:
-	  //radius of the sphere has been removed
-    phys::DrawSphere(Ent_->GetPosition(), 0.05f, col_);
-    break;
-  case BOX:
-    phys::DrawCube(Ent_->GetPosition(), Ent_->GetScale(), col_);
-    break;
-  default:
-    phys::DrawSphere(Ent_->GetPosition(), 0.05f, col_);
-    break;
-  }
-}
+const vector<ComponentPtr> *Entity::GetComponents() const { return &components_; }
@@ -1,8 +1,11 @@
 #pragma once
+#include "ecs.h"
+#include <cstdint>
 #include <glm/gtc/quaternion.hpp>
 #include <memory>
 #include <phys_utils.h>
 #include <string>
+#include <typeinfo>
 #include <vector>
 
 class Entity;
@@ -13,8 +16,9 @@ protected:
   bool active_;
 
 public:
-  std::string token_;
-  Component(const std::string &token);
+  //name the component is found by in GetComponents, a string literal so components don't carry a string each
+  const char *token_;
+  Component(const char *token);
   virtual ~Component();
   virtual void Update(double delta){};
   virtual void Render(){};
@@ -33,6 +37,15 @@ public:
 //	float inverseMass;
 //};
 
+//Deleter of the components an entity holds: owned components are deleted, components living in a pool
+//(see ParticlePool) are only destroyed and their memory goes back with the pool.
+struct ComponentDeleter {
+  bool owned;
+  ComponentDeleter(bool own = true) : owned(own) {}
+  void operator()(Component *c) const;
+};
+typedef std::unique_ptr<Component, ComponentDeleter> ComponentPtr;
+
 class Entity {
 protected:
   bool visible_;
@@ -42,7 +55,9 @@ protected:
   glm::vec3 position_;
   glm::quat rotation_;
   glm::mat4 transform_;
-  std::vector<std::unique_ptr<Component>> components_;
+  std::vector<ComponentPtr> components_;
+  //this entity in the world, whose column for every component type holds the first Component * of that type
+  EntityId id_;
 
 public:
   phys::RGBAInt32 colour;
@@ -70,27 +85,39 @@ public:
   virtual void Render();
 
   void AddComponent(std::unique_ptr<Component> &c);
+  void AddComponent(std::unique_ptr<Component> &&c);
+  //adds a component whose memory belongs to someone else (a pool), the entity only destroys it
+  void AttachComponent(Component *c);
+  //room for n components, so entities built in bulk don't grow their list one by one
+  void ReserveComponents(size_t n);
   void RemoveComponent(Component &c);
-  const std::vector<std::unique_ptr<Component>> *GetComponents() const;
+  const std::vector<ComponentPtr> *GetComponents() const;
   std::vector<Component *> GetComponents(std::string const &name) const;
 
-  template <typename T> T *const getComponent() {
-    for (std::vector<Component *>::iterator it = components_.begin(); it != components_.end(); ++it) {
-      // printf("Checking %s against %s \n", typeid(**it).name(),
-      // typeid(T).name());
-      if (&typeid(**it) == &typeid(T)) {
-        return static_cast<T *>(*it);
-      }
-    }
-    return NULL;
+  //component of exactly type T in O(1) without allocating, nullptr if there is none
+  template <typename T> T *getComponent() const {
+    Component *const *c = static_cast<Component *const *>(GetWorld().GetRaw(id_, ComponentTypeId<T>()));
+    return c ? static_cast<T *>(*c) : nullptr;
   }
+  EntityId GetId() const { return id_; }
 };
 
+//Calls fn(T *) on the first T of every entity, walking the world's dense columns instead of the entities.
+//Components only reach the world through Entity::AddComponent, so this is the adapter systems use for them.
+template <typename T, typename F> void EachComponent(F fn) {
+  GetWorld().EachRaw<Component *>(ComponentTypeId<T>(), [&fn](size_t count, const EntityId *, Component **c) {
+    for (size_t i = 0; i < count; ++i) {
+      fn(static_cast<T *>(c[i]));
+    }
+  });
+}
+
 class cShapeRenderer : public Component {
 public:
   enum SHAPES { SPHERE, BOX };
   const SHAPES shape;
   void SetColour(const phys::RGBAInt32 c);
+  phys::RGBAInt32 GetColour() const;
   cShapeRenderer(SHAPES shape);
   ~cShapeRenderer();
   void Update(double delta);
@@ -0,0 +1,1035 @@
+#include "broadphase.h"
+#include "cloth.h"
+#include "clothmesh.h"
+#include "implicit.h"
+#include "integrate.h"
+#include "jobs.h"
+#include "physics.h"
+#include "pipeline.h"
+#include "scheduler.h"
+#include "selfcollision.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+using namespace glm;
+
+//Headless driver: builds the cloth without any window, steps it for a number of ticks and reports timings.
+//usage: phys_headless [--rows N] [--ticks N] [--dt seconds] [--substeps N] [--frame-time seconds] [--max-catch-up N]
+//                     [--threads N] [--solver springs|xpbd|implicit|multigrid] [--iterations N] [--cg-iterations N]
+//                     [--tolerance r] [--integrator auto|scalar|sse|avx2]
+//                     [--verify-integrator] [--bench-springs] [--bench-broadphase] [--bench-self-collision]
+//                     [--bench-components] [--bench-cloth-build] [--bench-mesh] [--bench-debug-draw] [--bench-solvers]
+//                     [--bench-multigrid] [--bench-adaptive] [--bench-sleep] [--adaptive] [--max-strain s]
+//                     [--max-displacement d] [--no-sync] [--pipeline] [--deterministic]
+//--pipeline ticks on a simulation thread in real time while the main thread plays the renderer, reading a snapshot
+//every frame time; the frames are then wall clock frames and the report adds the snapshot latency.
+
+typedef chrono::high_resolution_clock timer;
+
+//FNV-1a hash of the bits of every particle position, equal runs give equal hashes
+static uint64_t stateHash(const ParticleStore &ps) {
+  uint64_t h = 14695981039346656037ull;
+  const vector<float> *axes[3] = {&ps.px, &ps.py, &ps.pz};
+  for (auto axis : axes) {
+    for (size_t i = 0; i < ps.Size(); ++i) {
+      uint32_t bits;
+      memcpy(&bits, &(*axis)[i], sizeof(bits));
+      h = (h ^ bits) * 1099511628211ull;
+    }
+  }
+  return h;
+}
+
+//every heap allocation made by the process, to check the steady state of the simulation allocates nothing
+static atomic<size_t> allocations(0);
+
+//the replacements stay out of line: inlined into their callers, GCC would see malloc and free paired with new and
+//delete and warn about the mismatch
+#if defined(_MSC_VER)
+#define COUNTED_ALLOC __declspec(noinline)
+#else
+#define COUNTED_ALLOC __attribute__((noinline))
+#endif
+
+COUNTED_ALLOC void *operator new(size_t size) {
+  ++allocations;
+  void *p = malloc(size ? size : 1);
+  if (!p) {
+    throw bad_alloc();
+  }
+  return p;
+}
+
+COUNTED_ALLOC void *operator new[](size_t size) { return operator new(size); }
+
+COUNTED_ALLOC void operator delete(void *p) noexcept { free(p); }
+
+COUNTED_ALLOC void operator delete[](void *p) noexcept { free(p); }
+
+COUNTED_ALLOC void operator delete(void *p, size_t) noexcept { free(p); }
+
+COUNTED_ALLOC void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static double elapsedMs(timer::time_point from, timer::time_point to) {
+  return chrono::duration<double, milli>(to - from).count();
+}
+
+static bool parseIntegrator(const char *name, IntegratorKind &kind) {
+  const IntegratorKind kinds[] = {INTEGRATOR_AUTO, INTEGRATOR_SCALAR, INTEGRATOR_SSE, INTEGRATOR_AVX2};
+  for (auto k : kinds) {
+    if (!strcmp(name, IntegratorName(k))) {
+      kind = k;
+      return true;
+    }
+  }
+  return false;
+}
+
+//runs every supported kernel on the same random particles and compares with the scalar kernel
+static bool verifyIntegrators() {
+  const size_t count = 100003;
+  ParticleStore reference;
+  srand(1);
+  for (size_t i = 0; i < count; ++i) {
+    auto r = []() { return (float)rand() / RAND_MAX * 2.0f - 1.0f; };
+    reference.Add(nullptr, vec3(r(), r(), r()) * 10.0f, 0.5 + (double)rand() / RAND_MAX);
+    reference.SetPrevPosition(i, reference.Position(i) + vec3(r(), r(), r()) * 0.01f);
+    reference.AddForce(i, vec3(r(), r(), r()) * 50.0f);
+    reference.pinned[i] = (rand() % 10) == 0;
+  }
+  const float dt2 = (1.0f / 60.0f) * (1.0f / 60.0f);
+  ParticleStore expected = reference;
+  IntegrateScalar(expected, dt2, 0, count);
+
+  bool ok = true;
+  const IntegratorKind kinds[] = {INTEGRATOR_SSE, INTEGRATOR_AVX2};
+  for (auto k : kinds) {
+    if (!IntegratorSupported(k)) {
+      cout << IntegratorName(k) << ": not supported on this cpu" << endl;
+      continue;
+    }
+    ParticleStore result = reference;
+    SetIntegrator(k);
+    Integrate(result, dt2);
+    float maxError = 0.0f;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const float e[] = {result.px[i] - expected.px[i], result.py[i] - expected.py[i], result.pz[i] - expected.pz[i],
+                         result.ox[i] - expected.ox[i], result.oy[i] - expected.oy[i], result.oz[i] - expected.oz[i]};
+      for (float d : e) {
+        maxError = glm::max(maxError, fabsf(d));
+        mismatches += d != 0.0f;
+      }
+    }
+    const bool pass = maxError <= 1e-5f;
+    cout << IntegratorName(k) << ": ";
+    if (mismatches == 0) {
+      cout << "bit exact" << endl;
+    } else {
+      cout << mismatches << " values differ, max error " << maxError << (pass ? "" : " FAILED") << endl;
+    }
+    ok = ok && pass;
+  }
+  return ok;
+}
+
+//times the spring stage alone on a size x size cloth, from 1 thread up to maxThreads
+static void benchSprings(int size, size_t maxThreads) {
+  ParticleStore ps;
+  ps.Reserve(size_t(size) * size);
+  srand(1);
+  for (int x = 0; x < size; ++x) {
+    for (int z = 0; z < size; ++z) {
+      //slightly out of rest so every spring does some work
+      const float jitter = ((float)rand() / RAND_MAX) * 0.05f;
+      ps.Add(nullptr, vec3(x * 0.3f + jitter, 10.0f, z * 0.3f), 1.0);
+    }
+  }
+  SpringTopology springs;
+  BuildClothSprings(springs, size, 0.3f, 0);
+  const SpringParams params = {{95.0f, 90.0f, 80.0f, 20.0f}, 90.0f};
+  cout << "springs: " << springs.Size() << " in " << springs.Colors() << " colours, "
+       << springs.Size() - springs.serialFrom << " serial" << endl;
+
+  const int repeats = 20;
+  double single = 0.0;
+  //1, 2, 4... threads and finally maxThreads
+  for (size_t threads = 1;; threads = glm::min(threads * 2, maxThreads)) {
+    SetWorkerCount(threads);
+    EvaluateSpringsParallel(springs, params, ps, GetJobPool());
+    auto t0 = timer::now();
+    for (int i = 0; i < repeats; ++i) {
+      EvaluateSpringsParallel(springs, params, ps, GetJobPool());
+    }
+    const double ms = elapsedMs(t0, timer::now()) / repeats;
+    if (threads == 1) {
+      single = ms;
+    }
+    cout << threads << " threads: " << ms << " ms, speedup " << single / ms << ", efficiency "
+         << 100.0 * single / (ms * threads) << "%" << endl;
+    if (threads == maxThreads) {
+      break;
+    }
+  }
+}
+
+//pair count and time of the grid broadphase against testing every pair, at constant sphere density
+static void benchBroadphase() {
+  UniformGrid grid;
+  vector<SpherePair> pairs;
+  vector<float> x, y, z, r;
+  srand(1);
+  for (size_t count = 1024; count <= 262144; count *= 4) {
+    //box sized so there are ~4 spheres of radius 0.03 per 0.1 cube
+    const float side = cbrtf(count / 4.0f) * 0.1f;
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    r.assign(count, 0.03f);
+    for (size_t i = 0; i < count; ++i) {
+      x[i] = (float)rand() / RAND_MAX * side;
+      y[i] = (float)rand() / RAND_MAX * side;
+      z[i] = (float)rand() / RAND_MAX * side;
+    }
+    //once to warm the buffers up, then timed
+    pairs.clear();
+    grid.Build(x.data(), y.data(), z.data(), r.data(), count);
+    grid.FindPairs(pairs);
+    pairs.clear();
+    auto t0 = timer::now();
+    grid.Build(x.data(), y.data(), z.data(), r.data(), count);
+    grid.FindPairs(pairs);
+    const double gridMs = elapsedMs(t0, timer::now());
+
+    cout << count << " spheres: " << pairs.size() << " candidate pairs in " << gridMs << " ms";
+    const double allPairs = count * (count - 1.0) / 2.0;
+    if (count <= 16384) {
+      size_t overlapping = 0;
+      t0 = timer::now();
+      for (size_t i = 0; i < count; ++i) {
+        for (size_t j = i + 1; j < count; ++j) {
+          overlapping += fabsf(x[j] - x[i]) <= 0.06f && fabsf(y[j] - y[i]) <= 0.06f && fabsf(z[j] - z[i]) <= 0.06f;
+        }
+      }
+      cout << ", all pairs: " << allPairs << " tests (" << overlapping << " overlapping) in " << elapsedMs(t0, timer::now())
+           << " ms";
+    } else {
+      cout << ", all pairs: " << allPairs << " tests (not timed)";
+    }
+    cout << endl;
+  }
+}
+
+//self collision of a cloth folded in half onto itself, so every particle of the top layer is in contact, on one
+//thread and on the pool, which has to give the same particles bit for bit.
+//The time per particle stays about flat up to 65k particles; at 262k the grid outgrows the caches and every
+//search waits on memory, which the jobs spread over the threads.
+static void benchSelfCollision() {
+  const float spacing = 0.3f;
+  const float thickness = 0.75f * spacing;
+  JobPool serial(1);
+  JobPool &pool = GetJobPool();
+  for (int size = 64; size <= 512; size *= 2) {
+    const size_t count = size_t(size) * size;
+    ParticleStore folded;
+    folded.Reserve(count);
+    for (int x = 0; x < size; ++x) {
+      for (int z = 0; z < size; ++z) {
+        //the second half is mirrored back over the first, half a thickness above it
+        const bool top = x >= size / 2;
+        const float fx = (top ? size - 1 - x : x) * spacing;
+        folded.Add(nullptr, vec3(fx, top ? thickness * 0.5f : 0.0f, z * spacing), 1.0);
+      }
+    }
+    SpringTopology springs;
+    BuildClothSprings(springs, size, spacing, 0);
+    SelfCollision self;
+    auto t0 = timer::now();
+    self.Init(springs, 0, static_cast<uint32_t>(count), thickness);
+    const double initMs = elapsedMs(t0, timer::now());
+
+    //warm up on a copy, then time fresh copies so every step sees the same contacts
+    const int repeats = 5;
+    ParticleStore ps = folded;
+    size_t contacts = self.Step(ps, serial);
+    double ms[2] = {0.0, 0.0};
+    uint64_t hash[2] = {0, 0};
+    for (int run = 0; run < 2; ++run) {
+      for (int i = 0; i < repeats; ++i) {
+        ps = folded;
+        t0 = timer::now();
+        contacts = self.Step(ps, run ? pool : serial);
+        ms[run] += elapsedMs(t0, timer::now());
+      }
+      ms[run] /= repeats;
+      hash[run] = stateHash(ps);
+    }
+    cout << count << " particles: " << self.Pairs() << " candidate pairs, " << self.Excluded() << " spring neighbours, "
+         << contacts << " contacts, " << ms[0] << " ms/step, " << ms[0] * 1.0e6 / count << " ns/particle on 1 thread, "
+         << ms[1] << " ms/step, " << ms[1] * 1.0e6 / count << " ns/particle on " << pool.Size() << " (init " << initMs
+         << " ms)" << (hash[0] == hash[1] ? "" : " FAILED, the threads changed the result") << endl;
+  }
+}
+
+//string token lookup against the typed slot lookup, on entities built like the cloth particles
+static void benchComponents() {
+  const size_t count = 10000;
+  const int repeats = 50;
+  vector<unique_ptr<Entity>> entities;
+  for (size_t i = 0; i < count; ++i) {
+    entities.push_back(CreateParticle(0.0f, 0.0f, 0.0f, 1.0));
+  }
+  //sums the masses so the lookups can't be optimized away
+  double sum = 0.0;
+  size_t before = allocations;
+  auto t0 = timer::now();
+  for (int r = 0; r < repeats; ++r) {
+    for (auto &e : entities) {
+      sum += static_cast<cPhysics *>(e->GetComponents("Physics")[0])->GetMass();
+      sum += static_cast<cSphereCollider *>(e->GetComponents("SphereCollider")[0])->radius;
+    }
+  }
+  const double stringMs = elapsedMs(t0, timer::now());
+  const size_t stringAllocations = allocations - before;
+
+  before = allocations;
+  t0 = timer::now();
+  for (int r = 0; r < repeats; ++r) {
+    for (auto &e : entities) {
+      sum += e->getComponent<cPhysics>()->GetMass();
+      sum += e->getComponent<cSphereCollider>()->radius;
+    }
+  }
+  const double typedMs = elapsedMs(t0, timer::now());
+  const size_t typedAllocations = allocations - before;
+
+  const double lookups = 2.0 * count * repeats;
+  cout << "string: " << stringMs * 1.0e6 / lookups << " ns/lookup, " << stringAllocations / lookups << " allocs/lookup"
+       << endl;
+  cout << "typed:  " << typedMs * 1.0e6 / lookups << " ns/lookup, " << typedAllocations / lookups << " allocs/lookup"
+       << endl;
+  cout << "speedup " << stringMs / typedMs << " (checksum " << sum << ")" << endl;
+}
+
+//building and destroying size x size particles one heap allocation at a time against the pool
+static void benchClothBuild() {
+  for (int size = 100; size <= 400; size += 100) {
+    const size_t count = size_t(size) * size;
+    vector<unique_ptr<Entity>> heap;
+    size_t before = allocations;
+    auto t0 = timer::now();
+    for (int x = 0; x < size; ++x) {
+      for (int z = 0; z < size; ++z) {
+        heap.push_back(CreateParticle(x * 0.3f, 10.0f, z * 0.3f, 1.0));
+      }
+    }
+    auto t1 = timer::now();
+    const size_t heapAllocations = allocations - before;
+    heap.clear();
+    auto t2 = timer::now();
+    cout << count << " particles, heap: build " << elapsedMs(t0, t1) << " ms (" << (double)heapAllocations / count
+         << " allocs/particle), teardown " << elapsedMs(t1, t2) << " ms" << endl;
+
+    ParticlePool pool;
+    before = allocations;
+    t0 = timer::now();
+    pool.Reserve(count);
+    for (int x = 0; x < size; ++x) {
+      for (int z = 0; z < size; ++z) {
+        pool.Add(vec3(x * 0.3f, 10.0f, z * 0.3f), 1.0, 0.03f);
+      }
+    }
+    t1 = timer::now();
+    const size_t poolAllocations = allocations - before;
+    const bool full = pool.Add(vec3(0.0f), 1.0, 0.03f) == ParticlePool::invalidHandle && pool.Size() == count;
+    pool.Release();
+    t2 = timer::now();
+    cout << count << " particles, pool: build " << elapsedMs(t0, t1) << " ms (" << (double)poolAllocations / count
+         << " allocs/particle), teardown " << elapsedMs(t1, t2) << " ms, "
+         << (full ? "refuses a particle past capacity" : "FAILED, added a particle past capacity") << endl;
+  }
+}
+
+//packs the cloth mesh of a size x size grid the way the renderer did (copy every position into a vector, build the
+//triangle list, upload both) and the way ClothMesh does (indices once, positions and normals straight into the vertex
+//buffer), then checks the normals against summing the triangle normals over the index list
+static void benchMesh(int size) {
+  const size_t count = size_t(size) * size;
+  const int frames = 50;
+  vector<vec3> previous(count), current(count);
+  //a rippled sheet, so no two normals are the same
+  for (size_t i = 0; i < count; ++i) {
+    const float x = float(i / size), z = float(i % size);
+    previous[i] = vec3(x * 0.3f, sinf(x * 0.2f) * cosf(z * 0.3f), z * 0.3f);
+    current[i] = previous[i] + vec3(0.01f);
+  }
+  //stands in for the mapped GL buffer
+  vector<ClothVertex> mapped(count);
+
+  size_t before = allocations;
+  size_t bytes = 0;
+  auto t0 = timer::now();
+  for (int f = 0; f < frames; ++f) {
+    vector<vec3> grid;
+    for (size_t i = 0; i < count; ++i) {
+      grid.push_back(previous[i] + (current[i] - previous[i]) * 0.5f);
+    }
+    vector<uint32_t> indices;
+    phys::BuildGridIndices(size, indices);
+    for (size_t i = 0; i < count; ++i) {
+      mapped[i].position = grid[i];
+    }
+    bytes += grid.size() * sizeof(vec3) + indices.size() * sizeof(uint32_t);
+  }
+  const double rebuildMs = elapsedMs(t0, timer::now()) / frames;
+  cout << count << " vertices, rebuild: " << rebuildMs << " ms/frame, " << (double)(allocations - before) / frames
+       << " allocs/frame, " << bytes / frames / 1024 << " KiB/frame uploaded" << endl;
+
+  ClothMesh mesh;
+  mesh.SetGrid(size);
+  before = allocations;
+  t0 = timer::now();
+  for (int f = 0; f < frames; ++f) {
+    mesh.SetGrid(size);
+    mesh.SetPositions(previous.data(), current.data(), count, 0.5f);
+    mesh.Pack(mapped.data());
+  }
+  const double streamMs = elapsedMs(t0, timer::now()) / frames;
+  const ClothMeshStats &stats = mesh.Stats();
+  cout << count << " vertices, stream:  " << streamMs << " ms/frame, " << (double)(allocations - before) / frames
+       << " allocs/frame, " << stats.vertexBytes / stats.packs / 1024 << " KiB/frame uploaded, indices built "
+       << stats.indexBuilds << " time(s), " << stats.indexBytes / 1024 << " KiB" << endl;
+
+  //the packed vertices are the interpolated positions, in grid order
+  size_t wrong = 0;
+  for (size_t i = 0; i < count; ++i) {
+    wrong += mapped[i].position != previous[i] + (current[i] - previous[i]) * 0.5f;
+  }
+  size_t indexCount;
+  uint32_t version;
+  const uint32_t *indices = mesh.Indices(indexCount, version);
+  vector<vec3> normals(count, vec3(0.0f));
+  for (size_t t = 0; t < indexCount; t += 3) {
+    const vec3 a = mapped[indices[t]].position, b = mapped[indices[t + 1]].position, c = mapped[indices[t + 2]].position;
+    const vec3 n = cross(b - a, c - a);
+    for (int k = 0; k < 3; ++k) {
+      normals[indices[t + k]] += n;
+    }
+  }
+  float maxError = 0.0f;
+  for (size_t i = 0; i < count; ++i) {
+    maxError = glm::max(maxError, length(mapped[i].normal - normalize(normals[i])));
+  }
+  cout << "check: " << wrong << " wrong vertices, " << indexCount << " indices (expected "
+       << size_t(size - 1) * (size - 1) * 6 << "), normals within " << maxError << " of the reference" << endl;
+}
+
+//records the particles and springs of a size x size cloth into the debug draw batch, one call per primitive as the
+//components do and one call per kind as the demo does, and checks what would be uploaded
+static void benchDebugDraw(int size) {
+  const size_t count = size_t(size) * size;
+  const int frames = 50;
+  vector<vec3> centres(count);
+  vector<phys::RGBAInt32> colours(count);
+  vector<pair<vec3, vec3>> lines(count - 1);
+  for (size_t i = 0; i < count; ++i) {
+    centres[i] = vec3(float(i / size), 10.0f, float(i % size)) * 0.3f;
+    colours[i].i = static_cast<uint32_t>(i * 2654435761u);
+  }
+  for (size_t i = 0; i + 1 < count; ++i) {
+    lines[i] = make_pair(centres[i], centres[i + 1]);
+  }
+  phys::DebugBatch &batch = phys::GetDebugBatch();
+  for (int one = 1; one >= 0; --one) {
+    size_t before = 0;
+    size_t records = 0;
+    auto t0 = timer::now();
+    //the first frame warms the arrays up and isn't counted
+    for (int f = 0; f <= frames; ++f) {
+      if (f == 1) {
+        before = allocations;
+        t0 = timer::now();
+      }
+      batch.Clear();
+      if (one) {
+        for (size_t i = 0; i < count; ++i) {
+          phys::DrawSpheres(&centres[i], 1, 0.05f, nullptr, colours[i]);
+        }
+        for (auto &l : lines) {
+          phys::DrawLines(&l, 1, false);
+        }
+      } else {
+        phys::DrawSpheres(centres.data(), count, 0.05f, colours.data());
+        phys::DrawLines(lines.data(), lines.size(), false);
+      }
+      records = batch.Records();
+    }
+    const double ms = elapsedMs(t0, timer::now()) / frames;
+    const size_t bytes = batch.Spheres().size() * sizeof(phys::SphereInstance) +
+                         batch.OverlayLines().size() * sizeof(phys::LineVertex);
+    cout << count << " spheres and " << lines.size() << " lines, " << (one ? "one by one" : "batched  ") << ": " << ms
+         << " ms/frame to record, " << records << " calls into 2 draws, " << bytes / 1024 << " KiB/frame, "
+         << (double)(allocations - before) / frames << " allocs/frame" << endl;
+  }
+  size_t wrong = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const phys::SphereInstance &s = batch.Spheres()[i];
+    wrong += s.centre != centres[i] || s.radius != 0.05f || s.colour.i != colours[i].i;
+  }
+  for (size_t i = 0; i < lines.size(); ++i) {
+    wrong += batch.OverlayLines()[2 * i].position != lines[i].first ||
+             batch.OverlayLines()[2 * i + 1].position != lines[i].second;
+  }
+  cout << "check: " << wrong << " wrong instances, " << batch.Lines().size() << " depth tested line vertices" << endl;
+  batch.Clear();
+}
+
+//one tick of the cloth as the demo runs it on the simulation thread
+static void clothStep(double t, double dt) {
+  UpdatePhysics(t, dt);
+  fixCorners();
+}
+
+static bool parseSolver(const char *name, SolverKind &kind) {
+  for (int k = 0; k < SOLVER_KINDS; ++k) {
+    if (!strcmp(name, SolverName(SolverKind(k)))) {
+      kind = SolverKind(k);
+      return true;
+    }
+  }
+  return false;
+}
+
+//mean strain |length / rest - 1| of the stretch springs, how far the cloth sags: the same for two solvers at equal
+//visual stiffness. Also the top speed of the particles, infinite once a position isn't finite.
+static void clothState(double dt, float &meanStretch, float &topSpeed) {
+  const ParticleStore &ps = GetParticles();
+  meanStretch = 0.0f;
+  size_t stretch = 0;
+  for (size_t e = 0; e < clothSprings.Size(); ++e) {
+    if (clothSprings.type[e] == SPRING_STRETCH) {
+      meanStretch += fabsf(length(ps.Position(clothSprings.b[e]) - ps.Position(clothSprings.a[e])) /
+                               clothSprings.restLength[e] - 1.0f);
+      ++stretch;
+    }
+  }
+  meanStretch /= glm::max<size_t>(stretch, 1);
+  topSpeed = 0.0f;
+  for (size_t i = 0; i < ps.Size(); ++i) {
+    const float speed = length(ps.Velocity(i)) / static_cast<float>(dt);
+    if (!(speed <= topSpeed)) {
+      topSpeed = speed == speed ? speed : INFINITY;
+    }
+  }
+}
+
+//the demo's spring constants scaled together so the stretch constant is k, damping included
+static void setStiffness(float k) {
+  stretchConstant = k;
+  shearConstant = k * 90.0f / 95.0f;
+  bendingConstant = k * 80.0f / 95.0f;
+  diagonalBendingConstant = k * 20.0f / 95.0f;
+  dampingFactor = k * 90.0f / 95.0f;
+}
+
+//the largest tick length (1/30 halved up to 8 times) a solver stays stable at over seconds of simulated time, what a
+//simulated second costs at that tick length and the mean stretch strain it ends with. Stable is finite and slower
+//than 50 m/s: 2 seconds of free fall reach 20 m/s, anything faster is energy made up by the solver.
+static bool runSolver(SolverKind kind, float k, double seconds, double &dt, double &ms, float &meanStretch) {
+  SetSolver(kind);
+  dt = 1.0 / 30.0;
+  for (int halvings = 0; halvings <= 8; ++halvings, dt *= 0.5) {
+    setStiffness(k);
+    Cloth();
+    const int ticks = static_cast<int>(seconds / dt + 0.5);
+    auto t0 = timer::now();
+    for (int i = 0; i < ticks; ++i) {
+      clothStep(i * dt, dt);
+    }
+    ms = elapsedMs(t0, timer::now()) / seconds;
+    float topSpeed;
+    clothState(dt, meanStretch, topSpeed);
+    if (topSpeed < 50.0f) {
+      return true;
+    }
+  }
+  dt *= 2.0;
+  return false;
+}
+
+//the solvers compared at equal visual stiffness: for every spring constant the explicit springs set the stretch
+//strain the constant stands for, and the others have to sag no more than that. XPBD converges towards its
+//compliance with the iterations, so they are doubled until it does. Each solver runs at the largest tick it is
+//stable at, and the cost is per simulated second.
+static void benchSolvers() {
+  const double seconds = 2.0;
+  //a strain within this factor of the target counts as equally stiff
+  const float match = 1.1f;
+  const int maxIterations = 512;
+  const float constants[] = {95.0f, 1000.0f, 10000.0f};
+  const int iterations = GetSolverIterations();
+  for (float k : constants) {
+    double dt, ms;
+    float target;
+    if (!runSolver(SOLVER_SPRINGS, k, seconds, dt, ms, target)) {
+      cout << "k " << k << ", springs: unstable down to dt 1/" << 1.0 / dt << ", no strain to match" << endl;
+      continue;
+    }
+    cout << "k " << k << ", springs: dt 1/" << 1.0 / dt << ", " << ms << " ms per simulated s, stretch strain "
+         << target << endl;
+    for (int s = 0; s < SOLVER_KINDS; ++s) {
+      if (s == SOLVER_SPRINGS) {
+        continue;
+      }
+      float strain;
+      bool stable;
+      int n = iterations;
+      for (;; n *= 2) {
+        SetSolverIterations(n);
+        stable = runSolver(SolverKind(s), k, seconds, dt, ms, strain);
+        if (s != SOLVER_XPBD || !stable || strain <= target * match || n >= maxIterations) {
+          break;
+        }
+      }
+      cout << "k " << k << ", " << SolverName(SolverKind(s)) << ": ";
+      if (!stable) {
+        cout << "unstable down to dt 1/" << 1.0 / dt << endl;
+        continue;
+      }
+      cout << "dt 1/" << 1.0 / dt << ", ";
+      if (s == SOLVER_XPBD) {
+        cout << n << " iterations, ";
+      }
+      cout << ms << " ms per simulated s, stretch strain " << strain
+           << (strain <= target * match ? "" : ", softer than the springs") << endl;
+    }
+  }
+  SetSolverIterations(iterations);
+  SetSolver(SOLVER_SPRINGS);
+}
+
+//conjugate gradient iterations per tick of the implicit solver with and without multigrid as the cloth grows, on a
+//stiff cloth (k 100000) at 1/30 s ticks solved to 1e-4: without it the iterations grow with the rows, with it they
+//should stay about the same
+static void benchMultigrid() {
+  const double dt = 1.0 / 30.0;
+  const int ticks = 10;
+  const SolverKind kinds[] = {SOLVER_IMPLICIT, SOLVER_MULTIGRID};
+  SetImplicitLimits(5000, 1.0e-4f);
+  setStiffness(100000.0f);
+  for (int size = 32; size <= 256; size *= 2) {
+    rows = size;
+    for (auto kind : kinds) {
+      SetSolver(kind);
+      Cloth();
+      //the first tick builds the structures and isn't counted
+      clothStep(0.0, dt);
+      int iterations = 0, worst = 0;
+      auto t0 = timer::now();
+      for (int i = 1; i <= ticks; ++i) {
+        clothStep(i * dt, dt);
+        iterations += GetImplicitStats().iterations;
+        worst = glm::max(worst, GetImplicitStats().iterations);
+      }
+      const double ms = elapsedMs(t0, timer::now()) / ticks;
+      cout << size << "x" << size << ", " << SolverName(kind) << ": " << GetImplicitStats().levels << " level(s), "
+           << (double)iterations / ticks << " cg iterations per tick (worst " << worst << "), " << ms << " ms/tick"
+           << endl;
+    }
+  }
+  SetSolver(SOLVER_SPRINGS);
+}
+
+//steps the adaptive ticks took, and how many of each size
+static void printAdaptive(const AdaptiveStats &a, double tick, uint64_t ticks) {
+  cout << "adaptive:  " << a.steps << " steps (" << (double)a.steps / glm::max<uint64_t>(ticks, 1) << " per tick), "
+       << a.rollbacks << " rolled back, " << a.overLimit << " over the limits, last strain change " << a.lastStrain
+       << ", displacement " << a.lastDisplacement << endl;
+  cout << "step dt:  ";
+  for (int k = 0; k < AdaptiveStats::levels; ++k) {
+    if (a.histogram[k]) {
+      cout << " 1/" << (1 << k) / tick << " x " << a.histogram[k];
+    }
+  }
+  cout << endl;
+}
+
+//one phase of benchAdaptive: ticks of 1/60 s, with wind on every particle every tick when wind isn't zero
+static void runAdaptivePhase(FixedStepScheduler &scheduler, const char *name, int ticks, vec3 wind) {
+  scheduler.ResetStats();
+  for (int i = 0; i < ticks; ++i) {
+    if (wind != vec3(0.0f)) {
+      generateWind(wind);
+    }
+    scheduler.Advance(scheduler.TickLength());
+    fixCorners();
+  }
+  const SchedulerStats &stats = scheduler.Stats();
+  float meanStretch, topSpeed;
+  clothState(scheduler.LastStep(), meanStretch, topSpeed);
+  cout << "  " << name << ": " << stats.averageStepMs << " ms/tick, " << (double)stats.substeps / stats.ticks
+       << " steps per tick, " << (topSpeed < 50.0f ? "stable" : "unstable") << endl;
+  if (scheduler.Adaptive()) {
+    printAdaptive(scheduler.GetAdaptiveStats(), scheduler.TickLength(), stats.ticks);
+  }
+}
+
+//cost of the default cloth at 1/60 s ticks, at rest and in a strong wind, with one fixed step per tick and with
+//adaptive steps: at rest the adaptive ticks should cost about the same as fixed ones, and in the wind they take
+//smaller steps, and cost more, for as long as the wind shakes the cloth harder than the limits allow. Adaptive steps
+//never get longer than the tick, so they can't be cheaper than fixed ones.
+static void benchAdaptive(const AdaptiveLimits &limits) {
+  const vec3 wind(20.0f, 80.0f, 0.0f);
+  for (int adaptive = 0; adaptive < 2; ++adaptive) {
+    Cloth();
+    FixedStepScheduler scheduler(60.0, 1, 1);
+    scheduler.SetStep(clothStep);
+    scheduler.SetAdaptive(adaptive != 0);
+    scheduler.SetAdaptiveLimits(limits);
+    cout << (adaptive ? "adaptive steps" : "fixed steps") << ":" << endl;
+    //drape first, 10 simulated seconds
+    runAdaptivePhase(scheduler, "draping", 600, vec3(0.0f));
+    runAdaptivePhase(scheduler, "at rest", 300, vec3(0.0f));
+    runAdaptivePhase(scheduler, "in wind", 300, wind);
+    runAdaptivePhase(scheduler, "calming", 300, vec3(0.0f));
+  }
+}
+
+//ticks of 1/60 s until every tile of the cloth is asleep, at most two simulated minutes, and what they cost
+static int runUntilAsleep(double &ms, size_t &peakAwake) {
+  const double dt = 1.0 / 60.0;
+  int ticks = 0;
+  peakAwake = 0;
+  auto t0 = timer::now();
+  for (; ticks < 7200 && !clothSleep.AllAsleep(); ++ticks) {
+    UpdatePhysics(ticks * dt, dt);
+    peakAwake = glm::max(peakAwake, clothSleep.Stats().awakeParticles);
+  }
+  ms = elapsedMs(t0, timer::now()) / glm::max(ticks, 1);
+  return ticks;
+}
+
+//a size x size cloth dropped flat on the floor: how long until all of it sleeps, what a tick at rest costs with and
+//without sleeping, how much of the cloth a push on its centre wakes and for how long, and whether a sphere moved by
+//its entity, or an awake particle of the cloth itself, wakes the sleeping cloth it is pressed into; false if not
+static bool benchSleep(int size) {
+  const double dt = 1.0 / 60.0;
+  const int restTicks = 600;
+  rows = size;
+  Cloth();
+  unique_ptr<Entity> floorEnt(new Entity());
+  floorEnt->AddComponent(unique_ptr<Component>(new cPlaneCollider()));
+  double ms;
+  size_t peakAwake;
+  int ticks = runUntilAsleep(ms, peakAwake);
+  cout << size << "x" << size << ", " << clothSleep.Stats().sleepingTiles << " tiles: "
+       << (clothSleep.AllAsleep() ? "all asleep after " : "still awake after ") << ticks << " ticks, " << ms
+       << " ms/tick" << endl;
+  auto t0 = timer::now();
+  for (int i = 0; i < restTicks; ++i) {
+    UpdatePhysics(i * dt, dt);
+  }
+  cout << "at rest, sleeping: " << elapsedMs(t0, timer::now()) / restTicks << " ms/tick" << endl;
+
+  clothSleep.ResetStats();
+  getParticle(size / 2, size / 2)->AddImpulse(vec3(0.0f, 300.0f, 0.0f));
+  ticks = runUntilAsleep(ms, peakAwake);
+  cout << "after a push: " << clothSleep.Stats().wakes << " wakes, at most " << peakAwake << " of " << size * size
+       << " particles awake, asleep again after " << ticks << " ticks, " << ms << " ms/tick" << endl;
+
+  // a ball without a body of its own, lowered into the middle of the sleeping cloth
+  clothSleep.ResetStats();
+  const vec3 centre = GetParticles().Position(getParticle(size / 2, size / 2)->index);
+  unique_ptr<Entity> ballEnt(new Entity());
+  cSphereCollider *ball = new cSphereCollider();
+  ball->radius = 0.5;
+  ballEnt->AddComponent(unique_ptr<Component>(ball));
+  for (int i = 0; i < 30; ++i) {
+    ballEnt->SetPosition(centre + vec3(0.0f, 1.0f - 0.04f * i, 0.0f));
+    UpdatePhysics(i * dt, dt);
+  }
+  const bool woken = clothSleep.Stats().wakes > 0;
+  cout << "kinematic sphere pressed in: " << clothSleep.Stats().wakes << " wakes, "
+       << (woken ? "ok" : "FAILED, the cloth slept through it") << endl;
+  ballEnt.reset();
+
+  // a particle of one tile woken and laid on a sleeping particle of the far tile, the self collision has to wake it
+  runUntilAsleep(ms, peakAwake);
+  ParticleStore &ps = GetParticles();
+  const size_t mover = getParticle(1, 1)->index;
+  const size_t sleeper = getParticle(size - 2, size - 2)->index;
+  clothSleep.Wake(ps, mover);
+  const vec3 onTop = ps.Position(sleeper) + vec3(0.0f, clothSelfCollision.Thickness() * 0.5f, 0.0f);
+  ps.SetPosition(mover, onTop);
+  ps.SetPrevPosition(mover, onTop);
+  clothSelfCollision.Step(ps, GetJobPool(), &clothSleep);
+  const bool selfWoken = !(ps.pinned[sleeper] & PARTICLE_ASLEEP);
+  cout << "self contact with a sleeping tile: " << (selfWoken ? "ok" : "FAILED, the tile slept through it") << endl;
+
+  clothSleep.WakeAll(GetParticles());
+  SetSleep(nullptr);
+  t0 = timer::now();
+  for (int i = 0; i < restTicks; ++i) {
+    UpdatePhysics(i * dt, dt);
+  }
+  cout << "at rest, no sleeping: " << elapsedMs(t0, timer::now()) / restTicks << " ms/tick" << endl;
+  return woken && selfWoken;
+}
+
+int main(int argc, char *argv[]) {
+  //frames to run, one tick each unless the frame time says otherwise
+  int ticks = 600;
+  double dt = 1.0 / 60.0;
+  int substeps = 1;
+  //real time per frame, 0 = one tick
+  double frameTime = 0.0;
+  int maxCatchUp = 5;
+  //0 = one per hardware thread
+  int threads = 0;
+  //copy the particle positions to the entities every tick, as the demo does when it draws the particles
+  bool sync = true;
+  //run the simulation on its own thread, the way the demo does
+  bool pipelined = false;
+  //gather the results of parallel jobs in a fixed order, so any thread count gives the same state
+  bool deterministic = false;
+  //conjugate gradient steps per tick of the implicit solver at most, and the relative residual it stops at
+  int cgIterations = 100;
+  float tolerance = 1.0e-3f;
+  //steps of the tick halved or doubled to keep the motion of one step under the limits, instead of fixed substeps
+  bool adaptive = false;
+  AdaptiveLimits limits = FixedStepScheduler().GetAdaptiveLimits();
+  enum { BENCH_NONE, BENCH_SPRINGS, BENCH_BROADPHASE, BENCH_SELF_COLLISION, BENCH_COMPONENTS, BENCH_CLOTH_BUILD, BENCH_MESH,
+         BENCH_DEBUG_DRAW, BENCH_SOLVERS, BENCH_MULTIGRID, BENCH_ADAPTIVE, BENCH_SLEEP } bench = BENCH_NONE;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--rows") && i + 1 < argc) {
+      rows = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--ticks") && i + 1 < argc) {
+      ticks = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--dt") && i + 1 < argc) {
+      dt = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--substeps") && i + 1 < argc) {
+      substeps = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--frame-time") && i + 1 < argc) {
+      frameTime = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--max-catch-up") && i + 1 < argc) {
+      maxCatchUp = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--integrator") && i + 1 < argc) {
+      IntegratorKind kind;
+      if (!parseIntegrator(argv[++i], kind) || !SetIntegrator(kind)) {
+        cerr << "integrator " << argv[i] << " is not available" << endl;
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--solver") && i + 1 < argc) {
+      SolverKind kind;
+      if (!parseSolver(argv[++i], kind)) {
+        cerr << "solver " << argv[i] << " is not available" << endl;
+        return 1;
+      }
+      SetSolver(kind);
+    } else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+      SetSolverIterations(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--cg-iterations") && i + 1 < argc) {
+      cgIterations = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+      tolerance = static_cast<float>(atof(argv[++i]));
+    } else if (!strcmp(argv[i], "--adaptive")) {
+      adaptive = true;
+    } else if (!strcmp(argv[i], "--max-strain") && i + 1 < argc) {
+      limits.maxStrain = static_cast<float>(atof(argv[++i]));
+    } else if (!strcmp(argv[i], "--max-displacement") && i + 1 < argc) {
+      limits.maxDisplacement = static_cast<float>(atof(argv[++i]));
+    } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--no-sync")) {
+      sync = false;
+    } else if (!strcmp(argv[i], "--pipeline")) {
+      pipelined = true;
+    } else if (!strcmp(argv[i], "--deterministic")) {
+      deterministic = true;
+    } else if (!strcmp(argv[i], "--verify-integrator")) {
+      return verifyIntegrators() ? 0 : 1;
+    } else if (!strcmp(argv[i], "--bench-springs")) {
+      bench = BENCH_SPRINGS;
+    } else if (!strcmp(argv[i], "--bench-broadphase")) {
+      bench = BENCH_BROADPHASE;
+    } else if (!strcmp(argv[i], "--bench-self-collision")) {
+      bench = BENCH_SELF_COLLISION;
+    } else if (!strcmp(argv[i], "--bench-components")) {
+      bench = BENCH_COMPONENTS;
+    } else if (!strcmp(argv[i], "--bench-cloth-build")) {
+      bench = BENCH_CLOTH_BUILD;
+    } else if (!strcmp(argv[i], "--bench-mesh")) {
+      bench = BENCH_MESH;
+    } else if (!strcmp(argv[i], "--bench-debug-draw")) {
+      bench = BENCH_DEBUG_DRAW;
+    } else if (!strcmp(argv[i], "--bench-solvers")) {
+      bench = BENCH_SOLVERS;
+    } else if (!strcmp(argv[i], "--bench-multigrid")) {
+      bench = BENCH_MULTIGRID;
+    } else if (!strcmp(argv[i], "--bench-adaptive")) {
+      bench = BENCH_ADAPTIVE;
+    } else if (!strcmp(argv[i], "--bench-sleep")) {
+      bench = BENCH_SLEEP;
+    } else {
+      cerr << "usage: " << argv[0] << " [--rows N] [--ticks N] [--dt seconds] [--substeps N] [--frame-time seconds]"
+           << " [--max-catch-up N] [--threads N] [--solver springs|xpbd|implicit|multigrid] [--iterations N]"
+           << " [--cg-iterations N] [--tolerance r]"
+           << " [--integrator auto|scalar|sse|avx2] [--verify-integrator] [--bench-springs] [--bench-broadphase]"
+           << " [--bench-self-collision] [--bench-components]"
+           << " [--bench-cloth-build] [--bench-mesh] [--bench-debug-draw] [--bench-solvers] [--bench-multigrid]"
+           << " [--bench-adaptive] [--bench-sleep] [--adaptive] [--max-strain s] [--max-displacement d]"
+           << " [--no-sync] [--pipeline] [--deterministic]" << endl;
+      return 1;
+    }
+  }
+  SetWorkerCount(threads);
+  GetJobPool().SetDeterministic(deterministic);
+  SetImplicitLimits(cgIterations, tolerance);
+
+  if (bench == BENCH_SPRINGS) {
+    benchSprings(rows, GetJobPool().Size());
+    return 0;
+  } else if (bench == BENCH_BROADPHASE) {
+    benchBroadphase();
+    return 0;
+  } else if (bench == BENCH_SELF_COLLISION) {
+    benchSelfCollision();
+    return 0;
+  } else if (bench == BENCH_COMPONENTS) {
+    benchComponents();
+    return 0;
+  } else if (bench == BENCH_CLOTH_BUILD) {
+    benchClothBuild();
+    return 0;
+  } else if (bench == BENCH_MESH) {
+    benchMesh(rows);
+    return 0;
+  } else if (bench == BENCH_DEBUG_DRAW) {
+    benchDebugDraw(rows);
+    return 0;
+  } else if (bench == BENCH_SOLVERS) {
+    benchSolvers();
+    return 0;
+  } else if (bench == BENCH_MULTIGRID) {
+    benchMultigrid();
+    return 0;
+  } else if (bench == BENCH_ADAPTIVE) {
+    benchAdaptive(limits);
+    return 0;
+  } else if (bench == BENCH_SLEEP) {
+    return benchSleep(rows) ? 0 : 1;
+  }
+  if (rows < 3 || ticks < 1 || dt <= 0.0 || substeps < 1 || frameTime < 0.0 || maxCatchUp < 1) {
+    cerr << "rows must be >= 3, ticks, substeps and max catch-up >= 1, dt > 0 and frame time >= 0" << endl;
+    return 1;
+  }
+  FixedStepScheduler scheduler(1.0 / dt, substeps, maxCatchUp);
+  scheduler.SetAdaptive(adaptive);
+  scheduler.SetAdaptiveLimits(limits);
+  if (frameTime == 0.0) {
+    frameTime = dt;
+  }
+
+  auto t0 = timer::now();
+  Cloth();
+  unique_ptr<Entity> floorEnt(new Entity());
+  floorEnt->AddComponent(unique_ptr<Component>(new cPlaneCollider()));
+  InitPhysics();
+  auto t1 = timer::now();
+
+  //same order of work as one frame of the demo (springs run inside the tick)
+  //allocations are only counted after the first frame, once everything is warmed up
+  size_t tickAllocations = 0;
+  SimPipeline pipeline(scheduler);
+  //sum of every position drawn, so the reads aren't optimised away
+  double drawn = 0.0;
+  if (pipelined) {
+    scheduler.SetStep(clothStep);
+    pipeline.Start();
+  }
+  for (int i = 0; i < ticks && pipelined; ++i) {
+    const size_t before = allocations;
+    const Snapshot &snapshot = pipeline.Latest();
+    const float alpha = pipeline.Alpha(snapshot);
+    for (size_t p = 0; p < snapshot.positions.size(); ++p) {
+      drawn += snapshot.Position(p, alpha).y;
+    }
+    this_thread::sleep_for(chrono::duration<double>(frameTime));
+    if (i > 0) {
+      tickAllocations += allocations - before;
+    }
+  }
+  pipeline.Stop();
+  for (int i = 0; i < ticks && !pipelined; ++i) {
+    const size_t before = allocations;
+    scheduler.Advance(frameTime);
+    if (sync) {
+      SyncTransforms();
+    }
+    for (auto &e : ClothParticles) {
+      e->Update(dt);
+    }
+    fixCorners();
+    if (i > 0) {
+      tickAllocations += allocations - before;
+    }
+  }
+  auto t2 = timer::now();
+  const int counted = glm::max(ticks - 1, 1);
+
+  const double setupMs = elapsedMs(t0, t1);
+  const double stepMs = elapsedMs(t1, t2);
+  const SchedulerStats &stats = scheduler.Stats();
+  cout << "particles: " << ClothParticles.size() << " (" << rows << "x" << rows << ")" << endl;
+  cout << "springs:   " << clothSprings.Size() << endl;
+  cout << "ticks:     " << stats.ticks << " x " << dt << "s in " << substeps << " substeps, " << stats.frames
+       << " frames of " << frameTime << "s" << endl;
+  cout << "dropped:   " << stats.droppedTime << "s in " << stats.cappedFrames << " capped frames" << endl;
+  cout << "tick cost: " << stats.averageStepMs << " ms average, " << stats.maxStepMs << " ms worst" << endl;
+  cout << "kernel:    " << IntegratorName(GetIntegrator()) << ", " << GetJobPool().Size() << " threads"
+       << (GetJobPool().Deterministic() ? ", deterministic" : "") << endl;
+  cout << "solver:    " << SolverName(GetSolver());
+  if (GetSolver() == SOLVER_XPBD) {
+    cout << ", " << GetSolverIterations() << " iterations";
+  } else if (GetSolver() == SOLVER_IMPLICIT) {
+    cout << ", last tick " << GetImplicitStats().iterations << " cg iterations, residual " << GetImplicitStats().residual
+         << ", structure built " << GetImplicitStats().builds << " time(s)";
+  } else if (GetSolver() == SOLVER_MULTIGRID) {
+    cout << ", " << GetImplicitStats().levels << " levels, last tick " << GetImplicitStats().iterations
+         << " cg iterations, residual " << GetImplicitStats().residual;
+  }
+  cout << endl;
+  if (adaptive) {
+    printAdaptive(scheduler.GetAdaptiveStats(), scheduler.TickLength(), stats.ticks);
+  }
+  const SleepStats &sleepStats = clothSleep.Stats();
+  cout << "sleep:     " << sleepStats.awakeParticles << " particles awake, " << sleepStats.sleepingParticles
+       << " asleep (" << sleepStats.sleepingTiles << " of " << sleepStats.awakeTiles + sleepStats.sleepingTiles
+       << " tiles), " << sleepStats.sleeps << " sleeps, " << sleepStats.wakes << " wakes, " << sleepStats.skippedTicks
+       << " ticks skipped" << endl;
+  cout << "jobs:      " << GetJobPool().JobsRun() << " run, " << GetJobPool().JobsStolen() << " stolen" << endl;
+  cout << "setup:     " << setupMs << " ms" << endl;
+  cout << "step:      " << stepMs << " ms total, " << stepMs / ticks << " ms/frame" << endl;
+  cout << "speed:     " << (scheduler.Time() * 1000.0) / stepMs << " simulated s per wall s" << endl;
+  //a warmed up frame has no reason to allocate, any allocation here is a regression
+  cout << "allocs:    " << (double)tickAllocations / counted << " per frame"
+       << (tickAllocations ? " FAILED, the steady state allocates" : "") << endl;
+  if (pipelined) {
+    const PipelineStats pstats = pipeline.Stats();
+    cout << "pipeline:  " << pstats.published << " snapshots published, " << pstats.consumed << " drawn" << endl;
+    cout << "latency:   " << pstats.averageLatencyMs << " ms average, " << pstats.maxLatencyMs << " ms worst"
+         << " (checksum " << drawn << ")" << endl;
+  }
+  cPhysics *centre = getParticle(rows / 2, rows / 2);
+  cout << "centre:    " << centre->getX() << ", " << centre->getY() << ", " << centre->getZ() << endl;
+  cout << "state:     " << hex << stateHash(GetParticles()) << dec << endl;
+
+  ShutdownPhysics();
+  return tickAllocations ? 1 : 0;
+}
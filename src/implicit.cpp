@@ -0,0 +1,361 @@
+#include "implicit.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+//springs per job while computing their forces and blocks, particles per job everywhere else
+static const size_t edgeGrain = 2048;
+static const size_t rowGrain = 2048;
+
+//particles the step leaves where they are
+static inline bool fixedParticle(const ParticleStore &ps, size_t i) { return ps.pinned[i] || ps.invMass[i] <= 0.0f; }
+
+ImplicitSolver::ImplicitSolver()
+    : maxIterations_(100), tolerance_(1.0e-3f), built_(false), edges_(0), gridFirst_(0), gridRows_(0),
+      useMultigrid_(false), multigridBuilt_(false) {
+  stats_.iterations = 0;
+  stats_.levels = 1;
+  stats_.residual = 0.0f;
+  stats_.builds = 0;
+}
+
+void ImplicitSolver::SetLimits(int maxIterations, float tolerance) {
+  maxIterations_ = max(maxIterations, 1);
+  tolerance_ = max(tolerance, 0.0f);
+}
+
+void ImplicitSolver::SetGrid(uint32_t first, size_t rows) {
+  gridFirst_ = first;
+  gridRows_ = rows;
+  multigridBuilt_ = false;
+}
+
+void ImplicitSolver::Build(const SpringTopology &t, size_t particles) {
+  const size_t edges = t.Size();
+  // springs around every particle, from both of their ends
+  incidenceStart_.assign(particles + 1, 0);
+  for (size_t e = 0; e < edges; ++e) {
+    if (t.a[e] != t.b[e]) {
+      ++incidenceStart_[t.a[e] + 1];
+      ++incidenceStart_[t.b[e] + 1];
+    }
+  }
+  for (size_t i = 0; i < particles; ++i) {
+    incidenceStart_[i + 1] += incidenceStart_[i];
+  }
+  incidenceEdge_.resize(incidenceStart_[particles]);
+  incidenceBlock_.resize(incidenceStart_[particles]);
+  vector<uint32_t> next(incidenceStart_.begin(), incidenceStart_.end() - 1);
+  for (size_t e = 0; e < edges; ++e) {
+    if (t.a[e] != t.b[e]) {
+      incidenceEdge_[next[t.a[e]]++] = static_cast<uint32_t>(e);
+      incidenceEdge_[next[t.b[e]]++] = static_cast<uint32_t>(e);
+    }
+  }
+  // one block per particle and distinct neighbour, two springs between the same particles share theirs
+  a_.rowStart.resize(particles + 1);
+  a_.column.clear();
+  diagonal_.resize(particles);
+  vector<uint32_t> columns;
+  for (size_t i = 0; i < particles; ++i) {
+    columns.assign(1, static_cast<uint32_t>(i));
+    for (uint32_t s = incidenceStart_[i]; s < incidenceStart_[i + 1]; ++s) {
+      const uint32_t e = incidenceEdge_[s];
+      columns.push_back(t.a[e] == i ? t.b[e] : t.a[e]);
+    }
+    sort(columns.begin(), columns.end());
+    columns.erase(unique(columns.begin(), columns.end()), columns.end());
+    const uint32_t first = static_cast<uint32_t>(a_.column.size());
+    a_.rowStart[i] = first;
+    a_.column.insert(a_.column.end(), columns.begin(), columns.end());
+    diagonal_[i] = first + static_cast<uint32_t>(lower_bound(columns.begin(), columns.end(), i) - columns.begin());
+    for (uint32_t s = incidenceStart_[i]; s < incidenceStart_[i + 1]; ++s) {
+      const uint32_t e = incidenceEdge_[s];
+      const uint32_t j = t.a[e] == i ? t.b[e] : t.a[e];
+      incidenceBlock_[s] = first + static_cast<uint32_t>(lower_bound(columns.begin(), columns.end(), j) - columns.begin());
+    }
+  }
+  a_.rowStart[particles] = static_cast<uint32_t>(a_.column.size());
+  a_.blocks.resize(9 * a_.column.size());
+  edgeForce_.resize(3 * edges);
+  edgeStiffness_.resize(6 * edges);
+  preconditioner_.resize(9 * particles);
+  for (auto v : {&x_, &r_, &z_, &p_, &q_}) {
+    v->resize(3 * particles);
+  }
+  partial_.resize(2 * JobPool::Chunks(particles, rowGrain));
+  edges_ = edges;
+  built_ = true;
+  // the levels follow the pattern of the matrix
+  multigridBuilt_ = false;
+  ++stats_.builds;
+}
+
+void ImplicitSolver::EdgeTerms(const SpringTopology &t, const SpringParams &k, const ParticleStore &ps, float dt,
+                               size_t begin, size_t end) {
+  const float dt2 = dt * dt;
+  for (size_t e = begin; e < end; ++e) {
+    const uint32_t i = t.a[e];
+    const uint32_t j = t.b[e];
+    const float dx = ps.px[j] - ps.px[i];
+    const float dy = ps.py[j] - ps.py[i];
+    const float dz = ps.pz[j] - ps.pz[i];
+    const float len = sqrtf(dx * dx + dy * dy + dz * dz);
+    // the damper of EvaluateSprings, on the displacement of the last tick
+    float *f = &edgeForce_[3 * e];
+    f[0] = -k.damping * ((ps.px[j] - ps.ox[j]) - (ps.px[i] - ps.ox[i]));
+    f[1] = -k.damping * ((ps.py[j] - ps.oy[j]) - (ps.py[i] - ps.oy[i]));
+    f[2] = -k.damping * ((ps.pz[j] - ps.oz[j]) - (ps.pz[i] - ps.oz[i]));
+    float *s = &edgeStiffness_[6 * e];
+    fill(s, s + 6, 0.0f);
+    if (len <= 0.0f) {
+      continue;
+    }
+    const float stiffness = k.stiffness[t.type[e]];
+    const float nx = dx / len, ny = dy / len, nz = dz / len;
+    const float magnitude = -stiffness * (len - t.restLength[e]);
+    f[0] += magnitude * nx;
+    f[1] += magnitude * ny;
+    f[2] += magnitude * nz;
+    // -df/dx is k (n n^T + (1 - rest / len) (I - n n^T)); the sideways part is dropped on a compressed spring, where
+    // it would be negative and the matrix could stop being positive definite
+    const float side = max(1.0f - t.restLength[e] / len, 0.0f);
+    const float along = dt2 * stiffness * (1.0f - side);
+    const float across = dt2 * stiffness * side;
+    s[0] = along * nx * nx + across;
+    s[1] = along * nx * ny;
+    s[2] = along * nx * nz;
+    s[3] = along * ny * ny + across;
+    s[4] = along * ny * nz;
+    s[5] = along * nz * nz + across;
+  }
+}
+
+void ImplicitSolver::AssembleRows(const SpringTopology &t, const SpringParams &k, const ParticleStore &ps, float dt,
+                                  size_t begin, size_t end) {
+  // the damper force is -damping dt (vj - vi), its velocity derivative times dt goes on the blocks' diagonal
+  const float damping = k.damping * dt * dt;
+  const glm::vec3 g = ps.gravity;
+  for (size_t i = begin; i < end; ++i) {
+    fill(&a_.blocks[9 * a_.rowStart[i]], &a_.blocks[9 * a_.rowStart[i + 1]], 0.0f);
+    float *d = &a_.blocks[9 * diagonal_[i]];
+    float *r = &r_[3 * i];
+    // a fixed particle keeps its velocity: identity row, nothing to solve for
+    if (fixedParticle(ps, i)) {
+      d[0] = d[4] = d[8] = 1.0f;
+      r[0] = r[1] = r[2] = 0.0f;
+      InvertBlock(d, &preconditioner_[9 * i]);
+      continue;
+    }
+    const float m = 1.0f / ps.invMass[i];
+    d[0] = d[4] = d[8] = m;
+    float fx = m * g.x + ps.fx[i], fy = m * g.y + ps.fy[i], fz = m * g.z + ps.fz[i];
+    float kx = 0.0f, ky = 0.0f, kz = 0.0f;
+    const float vx = (ps.px[i] - ps.ox[i]) / dt, vy = (ps.py[i] - ps.oy[i]) / dt, vz = (ps.pz[i] - ps.oz[i]) / dt;
+    for (uint32_t n = incidenceStart_[i]; n < incidenceStart_[i + 1]; ++n) {
+      const uint32_t e = incidenceEdge_[n];
+      const bool second = t.b[e] == i;
+      const uint32_t j = second ? t.a[e] : t.b[e];
+      const float *f = &edgeForce_[3 * e];
+      const float sign = second ? 1.0f : -1.0f;
+      fx += sign * f[0];
+      fy += sign * f[1];
+      fz += sign * f[2];
+      // dt^2 df/dx v, with a fixed neighbour standing still
+      const bool fixed = fixedParticle(ps, j);
+      const float wx = vx - (fixed ? 0.0f : (ps.px[j] - ps.ox[j]) / dt);
+      const float wy = vy - (fixed ? 0.0f : (ps.py[j] - ps.oy[j]) / dt);
+      const float wz = vz - (fixed ? 0.0f : (ps.pz[j] - ps.oz[j]) / dt);
+      const float *s = &edgeStiffness_[6 * e];
+      kx += s[0] * wx + s[1] * wy + s[2] * wz;
+      ky += s[1] * wx + s[3] * wy + s[4] * wz;
+      kz += s[2] * wx + s[4] * wy + s[5] * wz;
+      const float block[9] = {s[0] + damping, s[1], s[2], s[1], s[3] + damping, s[4], s[2], s[4], s[5] + damping};
+      // the columns of fixed particles stay empty, keeping the matrix symmetric
+      float *o = fixed ? nullptr : &a_.blocks[9 * incidenceBlock_[n]];
+      for (int c = 0; c < 9; ++c) {
+        d[c] += block[c];
+        if (o) {
+          o[c] -= block[c];
+        }
+      }
+    }
+    r[0] = dt * fx - kx;
+    r[1] = dt * fy - ky;
+    r[2] = dt * fz - kz;
+    InvertBlock(d, &preconditioner_[9 * i]);
+  }
+}
+
+double ImplicitSolver::Sum(size_t chunks, size_t which) const {
+  double sum = 0.0;
+  for (size_t c = 0; c < chunks; ++c) {
+    sum += partial_[2 * c + which];
+  }
+  return sum;
+}
+
+void ImplicitSolver::Step(const SpringTopology &t, const SpringParams &k, ParticleStore &ps, float dt, JobPool &pool) {
+  const size_t count = ps.Size();
+  if (!built_ || edges_ != t.Size() || a_.Rows() != count) {
+    Build(t, count);
+  }
+  if (useMultigrid_ && !multigridBuilt_) {
+    multigrid_.Build(a_, gridFirst_, gridRows_);
+    multigridBuilt_ = true;
+  }
+  stats_.iterations = 0;
+  stats_.residual = 0.0f;
+  if (!count) {
+    return;
+  }
+  pool.ParallelFor(t.Size(), edgeGrain, [&](size_t begin, size_t end) { EdgeTerms(t, k, ps, dt, begin, end); });
+  pool.ParallelFor(count, rowGrain, [&](size_t begin, size_t end) { AssembleRows(t, k, ps, dt, begin, end); });
+  // the coarse levels are made once the fine matrix is complete
+  const bool multigrid = useMultigrid_ && multigrid_.Levels() > 1;
+  if (multigrid) {
+    multigrid_.Update(a_, preconditioner_.data(), pool);
+  }
+
+  // every loop below goes over chunks of rows, so each chunk writes its own dot products
+  const size_t chunks = JobPool::Chunks(count, rowGrain);
+  float *x = x_.data(), *r = r_.data(), *z = z_.data(), *p = p_.data(), *q = q_.data();
+  const float *pre = preconditioner_.data();
+  auto chunkRows = [&](size_t chunk, size_t &begin, size_t &end) {
+    begin = chunk * rowGrain;
+    end = std::min(begin + rowGrain, count);
+  };
+  // z = P r, and the dot products r.z and r.r
+  auto precondition = [&](size_t i, double &rz, double &rr) {
+    const float *ri = &r[3 * i];
+    rr += double(ri[0]) * ri[0] + double(ri[1]) * ri[1] + double(ri[2]) * ri[2];
+    // the V-cycle needs the whole residual, it runs once the pass is over
+    if (multigrid) {
+      return;
+    }
+    const float *m = &pre[9 * i];
+    float *zi = &z[3 * i];
+    zi[0] = m[0] * ri[0] + m[1] * ri[1] + m[2] * ri[2];
+    zi[1] = m[3] * ri[0] + m[4] * ri[1] + m[5] * ri[2];
+    zi[2] = m[6] * ri[0] + m[7] * ri[1] + m[8] * ri[2];
+    rz += double(ri[0]) * zi[0] + double(ri[1]) * zi[1] + double(ri[2]) * zi[2];
+  };
+  // z = V-cycle of r and r.z, and p = z when starting
+  auto cycle = [&](bool start) {
+    multigrid_.Apply(r, z, pool);
+    pool.ParallelFor(chunks, 1, [&](size_t first, size_t last) {
+      for (size_t c = first; c < last; ++c) {
+        size_t begin, end;
+        chunkRows(c, begin, end);
+        double rz = 0.0;
+        for (size_t i = 3 * begin; i < 3 * end; ++i) {
+          rz += double(r[i]) * z[i];
+        }
+        if (start) {
+          copy(z + 3 * begin, z + 3 * end, p + 3 * begin);
+        }
+        partial_[2 * c] = rz;
+      }
+    });
+  };
+
+  // starting from no change of velocity, the residual is the right hand side
+  pool.ParallelFor(chunks, 1, [&](size_t first, size_t last) {
+    for (size_t c = first; c < last; ++c) {
+      size_t begin, end;
+      chunkRows(c, begin, end);
+      double rz = 0.0, rr = 0.0;
+      for (size_t i = begin; i < end; ++i) {
+        precondition(i, rz, rr);
+      }
+      fill(x + 3 * begin, x + 3 * end, 0.0f);
+      copy(z + 3 * begin, z + 3 * end, p + 3 * begin);
+      partial_[2 * c] = rz;
+      partial_[2 * c + 1] = rr;
+    }
+  });
+  if (multigrid) {
+    cycle(true);
+  }
+  double rz = Sum(chunks, 0);
+  const double bb = Sum(chunks, 1);
+  const double limit = double(tolerance_) * tolerance_ * bb;
+  double rr = bb;
+  int iterations = 0;
+  while (iterations < maxIterations_ && rr > limit) {
+    // q = A p and p.q
+    pool.ParallelFor(chunks, 1, [&](size_t first, size_t last) {
+      for (size_t c = first; c < last; ++c) {
+        size_t begin, end;
+        chunkRows(c, begin, end);
+        a_.Multiply(p, q, begin, end);
+        double pq = 0.0;
+        for (size_t i = 3 * begin; i < 3 * end; ++i) {
+          pq += double(p[i]) * q[i];
+        }
+        partial_[2 * c] = pq;
+      }
+    });
+    const double pq = Sum(chunks, 0);
+    if (!(pq > 0.0)) {
+      break;
+    }
+    const float alpha = static_cast<float>(rz / pq);
+    pool.ParallelFor(chunks, 1, [&](size_t first, size_t last) {
+      for (size_t c = first; c < last; ++c) {
+        size_t begin, end;
+        chunkRows(c, begin, end);
+        double rzc = 0.0, rrc = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+          for (size_t a = 3 * i; a < 3 * i + 3; ++a) {
+            x[a] += alpha * p[a];
+            r[a] -= alpha * q[a];
+          }
+          precondition(i, rzc, rrc);
+        }
+        partial_[2 * c] = rzc;
+        partial_[2 * c + 1] = rrc;
+      }
+    });
+    if (multigrid) {
+      cycle(false);
+    }
+    ++iterations;
+    const double rzNext = Sum(chunks, 0);
+    rr = Sum(chunks, 1);
+    if (rr <= limit) {
+      break;
+    }
+    const float beta = static_cast<float>(rzNext / rz);
+    rz = rzNext;
+    pool.ParallelFor(3 * count, 3 * rowGrain, [&](size_t begin, size_t end) {
+      for (size_t a = begin; a < end; ++a) {
+        p[a] = z[a] + beta * p[a];
+      }
+    });
+  }
+  stats_.iterations = iterations;
+  stats_.residual = bb > 0.0 ? static_cast<float>(sqrt(rr / bb)) : 0.0f;
+  stats_.levels = multigrid ? multigrid_.Levels() : 1;
+
+  // new velocity, and the position it reaches by the end of the tick
+  pool.ParallelFor(count, rowGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (!fixedParticle(ps, i)) {
+        const float vx = ps.px[i] - ps.ox[i] + dt * x[3 * i];
+        const float vy = ps.py[i] - ps.oy[i] + dt * x[3 * i + 1];
+        const float vz = ps.pz[i] - ps.oz[i] + dt * x[3 * i + 2];
+        ps.ox[i] = ps.px[i];
+        ps.oy[i] = ps.py[i];
+        ps.oz[i] = ps.pz[i];
+        ps.px[i] += vx;
+        ps.py[i] += vy;
+        ps.pz[i] += vz;
+      }
+      ps.fx[i] = 0.0f;
+      ps.fy[i] = 0.0f;
+      ps.fz[i] = 0.0f;
+    }
+  });
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "blocksparse.h"
+#include "jobs.h"
+#include "multigrid.h"
+#include "particles.h"
+#include "springs.h"
+#include <cstdint>
+#include <vector>
+
+//what the last implicit tick took
+struct ImplicitStats {
+  //conjugate gradient steps, and the residual they left relative to the right hand side
+  int iterations;
+  float residual;
+  //levels of the preconditioner, 1 for the diagonal blocks alone
+  size_t levels;
+  //times the matrix structure was built, once per spring topology
+  uint64_t builds;
+};
+
+//Backward Euler step of the springs: the spring and damper forces are linearised around the current positions into
+//(M - dt df/dv - dt^2 df/dx) dv = dt (f + dt df/dx v), assembled from the edge list into a block sparse matrix and
+//solved for the change of velocity with conjugate gradient, preconditioned by the inverse of the diagonal blocks or by
+//a multigrid V-cycle over the cloth grid.
+//The step stays stable at any stiffness and tick length, stiffer cloth only costs more iterations.
+//Assembly, products and dot products are spread over the job pool; the dot products add their chunks in a fixed
+//order, so the result is the same whatever the number of threads. Nothing allocates once the structure is built.
+class ImplicitSolver {
+public:
+  ImplicitSolver();
+  //conjugate gradient stops after maxIterations or once the residual is tolerance times the right hand side
+  void SetLimits(int maxIterations, float tolerance);
+  //the structure is built again on the next step (the springs changed)
+  void Invalidate() { built_ = false; }
+  //particles first to first + rows^2 - 1 are a rows x rows grid, x * rows + z, for the multigrid (rows 0 for none)
+  void SetGrid(uint32_t first, size_t rows);
+  //precondition with multigrid V-cycles instead of the diagonal blocks, when there is a grid big enough
+  void SetMultigrid(bool multigrid) { useMultigrid_ = multigrid; }
+  //moves every particle one tick of length dt under springs, damping, gravity and the forces accumulated on it,
+  //in place of the Verlet step, and clears the forces. Pinned particles don't move.
+  void Step(const SpringTopology &t, const SpringParams &k, ParticleStore &ps, float dt, JobPool &pool);
+  const ImplicitStats &Stats() const { return stats_; }
+
+private:
+  void Build(const SpringTopology &t, size_t particles);
+  void EdgeTerms(const SpringTopology &t, const SpringParams &k, const ParticleStore &ps, float dt, size_t begin, size_t end);
+  void AssembleRows(const SpringTopology &t, const SpringParams &k, const ParticleStore &ps, float dt, size_t begin, size_t end);
+  //sum of the chunk partials of the dot products, in chunk order
+  double Sum(size_t chunks, size_t which) const;
+
+  int maxIterations_;
+  float tolerance_;
+  //the structure is for a topology of edges_ springs over the rows of the matrix
+  bool built_;
+  size_t edges_;
+  uint32_t gridFirst_;
+  size_t gridRows_;
+  bool useMultigrid_;
+  bool multigridBuilt_;
+  ClothMultigrid multigrid_;
+  BlockSparseMatrix a_;
+  //springs around every particle: edge, the block it lands in, in the same rows as the matrix
+  std::vector<uint32_t> incidenceStart_;
+  std::vector<uint32_t> incidenceEdge_;
+  std::vector<uint32_t> incidenceBlock_;
+  std::vector<uint32_t> diagonal_;
+  //force on the second particle and dt^2 times the stiffness block (symmetric: xx, xy, xz, yy, yz, zz) of every spring
+  std::vector<float> edgeForce_;
+  std::vector<float> edgeStiffness_;
+  //inverse of the diagonal blocks
+  std::vector<float> preconditioner_;
+  //change of velocity, residual, preconditioned residual, search direction and its product, 3 floats per particle
+  std::vector<float> x_, r_, z_, p_, q_;
+  //dot products of every chunk of rows, two per chunk
+  std::vector<double> partial_;
+  ImplicitStats stats_;
+};
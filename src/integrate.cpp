@@ -0,0 +1,213 @@
+#include "integrate.h"
+#include "simd.h"
+#include <cstring>
+
+static IntegratorKind current = INTEGRATOR_SCALAR;
+static bool chosen = false;
+
+#ifdef PHYS_X86
+static bool cpuHasSSE2() {
+#if defined(_M_X64) || defined(__x86_64__)
+  return true;
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[3] & (1 << 26)) != 0;
+#else
+  return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool cpuHasAVX2() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  // the OS has to save the ymm registers too
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+bool IntegratorSupported(IntegratorKind kind) {
+  switch (kind) {
+  case INTEGRATOR_AUTO:
+  case INTEGRATOR_SCALAR:
+    return true;
+#ifdef PHYS_X86
+  case INTEGRATOR_SSE:
+    return cpuHasSSE2();
+  case INTEGRATOR_AVX2:
+    return cpuHasAVX2();
+#endif
+  default:
+    return false;
+  }
+}
+
+const char *IntegratorName(IntegratorKind kind) {
+  switch (kind) {
+  case INTEGRATOR_AUTO:
+    return "auto";
+  case INTEGRATOR_SCALAR:
+    return "scalar";
+  case INTEGRATOR_SSE:
+    return "sse";
+  case INTEGRATOR_AVX2:
+    return "avx2";
+  default:
+    return "unknown";
+  }
+}
+
+//widest kernel the cpu supports, found once by whichever thread asks first
+static IntegratorKind widestIntegrator() {
+  static const IntegratorKind widest =
+      IntegratorSupported(INTEGRATOR_AVX2) ? INTEGRATOR_AVX2
+                                           : (IntegratorSupported(INTEGRATOR_SSE) ? INTEGRATOR_SSE : INTEGRATOR_SCALAR);
+  return widest;
+}
+
+bool SetIntegrator(IntegratorKind kind) {
+  if (kind == INTEGRATOR_AUTO) {
+    kind = widestIntegrator();
+  }
+  if (!IntegratorSupported(kind)) {
+    return false;
+  }
+  current = kind;
+  chosen = true;
+  return true;
+}
+
+IntegratorKind GetIntegrator() {
+  // only SetIntegrator writes the choice, so jobs can ask while others integrate
+  return chosen ? current : widestIntegrator();
+}
+
+void Integrate(ParticleStore &ps, float dt2, size_t begin, size_t end) { Integrate(ps, dt2, begin, end, GetIntegrator()); }
+
+void Integrate(ParticleStore &ps, float dt2, size_t begin, size_t end, IntegratorKind kind) {
+  switch (kind) {
+  case INTEGRATOR_AVX2:
+    IntegrateAVX2(ps, dt2, begin, end);
+    break;
+  case INTEGRATOR_SSE:
+    IntegrateSSE(ps, dt2, begin, end);
+    break;
+  default:
+    IntegrateScalar(ps, dt2, begin, end);
+    break;
+  }
+}
+
+void Integrate(ParticleStore &ps, float dt2) { Integrate(ps, dt2, 0, ps.Size()); }
+
+void IntegrateScalar(ParticleStore &ps, float dt2, size_t begin, size_t end) {
+  const glm::vec3 g = ps.gravity;
+  for (size_t i = begin; i < end; ++i) {
+    // pinned particles keep their position, their forces are just dropped
+    if (!ps.pinned[i]) {
+      // velocity from current and previous position, then previous position to current position
+      const float vx = ps.px[i] - ps.ox[i];
+      const float vy = ps.py[i] - ps.oy[i];
+      const float vz = ps.pz[i] - ps.oz[i];
+      ps.ox[i] = ps.px[i];
+      ps.oy[i] = ps.py[i];
+      ps.oz[i] = ps.pz[i];
+      //force multiplied by inverse mass to get realism of interaction between cloth mass, gravity and forces
+      ps.px[i] += vx + (ps.fx[i] * ps.invMass[i] + g.x) * dt2;
+      ps.py[i] += vy + (ps.fy[i] * ps.invMass[i] + g.y) * dt2;
+      ps.pz[i] += vz + (ps.fz[i] * ps.invMass[i] + g.z) * dt2;
+    }
+    ps.fx[i] = 0.0f;
+    ps.fy[i] = 0.0f;
+    ps.fz[i] = 0.0f;
+  }
+}
+
+#ifdef PHYS_X86
+
+//one axis of 4 particles, pinned lanes are masked out instead of branched around
+static inline void stepSSE(float *p, float *o, float *f, size_t i, __m128 im, __m128 g, __m128 dt2, __m128 movable) {
+  const __m128 pos = _mm_loadu_ps(p + i);
+  const __m128 old = _mm_loadu_ps(o + i);
+  const __m128 v = _mm_sub_ps(pos, old);
+  const __m128 a = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(f + i), im), g);
+  const __m128 next = _mm_add_ps(pos, _mm_add_ps(v, _mm_mul_ps(a, dt2)));
+  _mm_storeu_ps(o + i, _mm_or_ps(_mm_and_ps(movable, pos), _mm_andnot_ps(movable, old)));
+  _mm_storeu_ps(p + i, _mm_or_ps(_mm_and_ps(movable, next), _mm_andnot_ps(movable, pos)));
+  _mm_storeu_ps(f + i, _mm_setzero_ps());
+}
+
+void IntegrateSSE(ParticleStore &ps, float dt2, size_t begin, size_t end) {
+  const __m128 vdt2 = _mm_set1_ps(dt2);
+  const __m128 gx = _mm_set1_ps(ps.gravity.x);
+  const __m128 gy = _mm_set1_ps(ps.gravity.y);
+  const __m128 gz = _mm_set1_ps(ps.gravity.z);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    // widen 4 pinned bytes to 32 bit lanes, movable lanes are all ones
+    int bits;
+    memcpy(&bits, &ps.pinned[i], sizeof(bits));
+    __m128i pinned = _mm_cvtsi32_si128(bits);
+    pinned = _mm_unpacklo_epi16(_mm_unpacklo_epi8(pinned, zero), zero);
+    const __m128 movable = _mm_castsi128_ps(_mm_cmpeq_epi32(pinned, zero));
+    const __m128 im = _mm_loadu_ps(&ps.invMass[i]);
+    stepSSE(&ps.px[0], &ps.ox[0], &ps.fx[0], i, im, gx, vdt2, movable);
+    stepSSE(&ps.py[0], &ps.oy[0], &ps.fy[0], i, im, gy, vdt2, movable);
+    stepSSE(&ps.pz[0], &ps.oz[0], &ps.fz[0], i, im, gz, vdt2, movable);
+  }
+  IntegrateScalar(ps, dt2, i, end);
+}
+
+//one axis of 8 particles
+PHYS_TARGET_AVX2 static inline void stepAVX2(float *p, float *o, float *f, size_t i, __m256 im, __m256 g, __m256 dt2,
+                                             __m256 movable) {
+  const __m256 pos = _mm256_loadu_ps(p + i);
+  const __m256 old = _mm256_loadu_ps(o + i);
+  const __m256 v = _mm256_sub_ps(pos, old);
+  const __m256 a = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(f + i), im), g);
+  const __m256 next = _mm256_add_ps(pos, _mm256_add_ps(v, _mm256_mul_ps(a, dt2)));
+  _mm256_storeu_ps(o + i, _mm256_blendv_ps(old, pos, movable));
+  _mm256_storeu_ps(p + i, _mm256_blendv_ps(pos, next, movable));
+  _mm256_storeu_ps(f + i, _mm256_setzero_ps());
+}
+
+PHYS_TARGET_AVX2 void IntegrateAVX2(ParticleStore &ps, float dt2, size_t begin, size_t end) {
+  const __m256 vdt2 = _mm256_set1_ps(dt2);
+  const __m256 gx = _mm256_set1_ps(ps.gravity.x);
+  const __m256 gy = _mm256_set1_ps(ps.gravity.y);
+  const __m256 gz = _mm256_set1_ps(ps.gravity.z);
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    const __m256i pinned = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(&ps.pinned[i])));
+    const __m256 movable = _mm256_castsi256_ps(_mm256_cmpeq_epi32(pinned, zero));
+    const __m256 im = _mm256_loadu_ps(&ps.invMass[i]);
+    stepAVX2(&ps.px[0], &ps.ox[0], &ps.fx[0], i, im, gx, vdt2, movable);
+    stepAVX2(&ps.py[0], &ps.oy[0], &ps.fy[0], i, im, gy, vdt2, movable);
+    stepAVX2(&ps.pz[0], &ps.oz[0], &ps.fz[0], i, im, gz, vdt2, movable);
+  }
+  IntegrateScalar(ps, dt2, i, end);
+}
+
+#else
+
+void IntegrateSSE(ParticleStore &ps, float dt2, size_t begin, size_t end) { IntegrateScalar(ps, dt2, begin, end); }
+
+void IntegrateAVX2(ParticleStore &ps, float dt2, size_t begin, size_t end) { IntegrateScalar(ps, dt2, begin, end); }
+
+#endif
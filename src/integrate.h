@@ -0,0 +1,23 @@
+#pragma once
+#include "particles.h"
+
+//Verlet integration kernels over the particle store.
+//All kernels do the same arithmetic in the same order, so the SIMD ones agree bit for bit with the scalar one.
+enum IntegratorKind { INTEGRATOR_AUTO, INTEGRATOR_SCALAR, INTEGRATOR_SSE, INTEGRATOR_AVX2 };
+
+//selects the kernel used by Integrate, AUTO picks the widest one the cpu supports. Returns false if not supported.
+bool SetIntegrator(IntegratorKind kind);
+//the kernel currently in use (never AUTO)
+IntegratorKind GetIntegrator();
+bool IntegratorSupported(IntegratorKind kind);
+const char *IntegratorName(IntegratorKind kind);
+
+//integrates particles [begin, end) with the selected kernel, dt2 is the squared timestep
+void Integrate(ParticleStore &ps, float dt2, size_t begin, size_t end);
+void Integrate(ParticleStore &ps, float dt2);
+//same with the given kernel (not AUTO), so parallel jobs all use the one picked before they started
+void Integrate(ParticleStore &ps, float dt2, size_t begin, size_t end, IntegratorKind kind);
+
+void IntegrateScalar(ParticleStore &ps, float dt2, size_t begin, size_t end);
+void IntegrateSSE(ParticleStore &ps, float dt2, size_t begin, size_t end);
+void IntegrateAVX2(ParticleStore &ps, float dt2, size_t begin, size_t end);
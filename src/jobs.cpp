@@ -0,0 +1,207 @@
+#include "jobs.h"
+#include <algorithm>
+
+using namespace std;
+
+//queue of the thread running, when it is a worker of that pool
+static thread_local const JobPool *workerPool = nullptr;
+static thread_local size_t workerQueue = 0;
+
+JobPool::JobPool(size_t threads) : queued_(0), quit_(false), deterministic_(false), jobsRun_(0), jobsStolen_(0) {
+  threads = max<size_t>(threads, 1);
+  for (size_t i = 0; i < threads; ++i) {
+    queues_.push_back(unique_ptr<Queue>(new Queue()));
+  }
+  for (size_t i = 1; i < threads; ++i) {
+    workers_.push_back(thread(&JobPool::WorkerLoop, this, i));
+  }
+}
+
+JobPool::~JobPool() {
+  {
+    lock_guard<mutex> lock(sleepMutex_);
+    quit_ = true;
+  }
+  wake_.notify_all();
+  for (auto &w : workers_) {
+    w.join();
+  }
+}
+
+size_t JobPool::OwnQueue() const { return workerPool == this ? workerQueue : 0; }
+
+void JobPool::Push(size_t queue, const Job *jobs, size_t count) {
+  if (!count) {
+    return;
+  }
+  {
+    Queue &q = *queues_[queue];
+    lock_guard<mutex> lock(q.mutex);
+    q.jobs.insert(q.jobs.end(), jobs, jobs + count);
+  }
+  queued_ += count;
+  // taking the lock orders the wake up after a worker that just found nothing has gone to sleep
+  { lock_guard<mutex> lock(sleepMutex_); }
+  if (count == 1) {
+    wake_.notify_one();
+  } else {
+    wake_.notify_all();
+  }
+}
+
+bool JobPool::Pop(size_t queue, Job &job) {
+  Queue &q = *queues_[queue];
+  lock_guard<mutex> lock(q.mutex);
+  if (q.jobs.size() == q.head) {
+    return false;
+  }
+  job = q.jobs.back();
+  q.jobs.pop_back();
+  if (q.jobs.size() == q.head) {
+    q.jobs.clear();
+    q.head = 0;
+  }
+  --queued_;
+  return true;
+}
+
+bool JobPool::Steal(size_t queue, Job &job) {
+  // oldest job first, it is the furthest away from what the owner is working on
+  for (size_t n = 1; n < queues_.size(); ++n) {
+    Queue &q = *queues_[(queue + n) % queues_.size()];
+    lock_guard<mutex> lock(q.mutex);
+    if (q.jobs.size() == q.head) {
+      continue;
+    }
+    job = q.jobs[q.head++];
+    if (q.jobs.size() == q.head) {
+      q.jobs.clear();
+      q.head = 0;
+    }
+    --queued_;
+    ++jobsStolen_;
+    return true;
+  }
+  return false;
+}
+
+void JobPool::Finish(const Job &job, size_t queue) {
+  JobCounter &c = *job.done;
+  // under the lock, so a thread waiting on the counter can't see it reach zero and destroy it while it is in use
+  lock_guard<mutex> lock(c.mutex_);
+  if (c.pending_.fetch_sub(1, memory_order_acq_rel) == 1 && !c.waiting_.empty()) {
+    Push(queue, c.waiting_.data(), c.waiting_.size());
+    c.waiting_.clear();
+  }
+}
+
+bool JobPool::RunOne(size_t queue) {
+  Job job;
+  if (!Pop(queue, job) && !Steal(queue, job)) {
+    return false;
+  }
+  if (job.task) {
+    job.task(job.data);
+  } else {
+    job.fn(job.ctx, job.begin, job.end);
+  }
+  ++jobsRun_;
+  Finish(job, queue);
+  return true;
+}
+
+void JobPool::Submit(TaskFn task, void *data, JobCounter &done, JobCounter *after) {
+  Job job = {nullptr, task, nullptr, data, 0, 0, &done};
+  done.pending_.fetch_add(1, memory_order_relaxed);
+  if (after) {
+    lock_guard<mutex> lock(after->mutex_);
+    if (!after->Done()) {
+      after->waiting_.push_back(job);
+      return;
+    }
+  }
+  Push(OwnQueue(), &job, 1);
+}
+
+void JobPool::Spread(size_t count, size_t grain, Job::Fn fn, const void *ctx, JobCounter &done, JobCounter *after) {
+  grain = grain ? grain : 1;
+  const size_t chunks = Chunks(count, grain);
+  if (!chunks) {
+    return;
+  }
+  done.pending_.fetch_add(static_cast<uint32_t>(chunks), memory_order_relaxed);
+  Job job = {fn, nullptr, ctx, nullptr, 0, 0, &done};
+  if (after) {
+    lock_guard<mutex> lock(after->mutex_);
+    if (!after->Done()) {
+      for (size_t c = 0; c < chunks; ++c) {
+        job.begin = c * grain;
+        job.end = min(job.begin + grain, count);
+        after->waiting_.push_back(job);
+      }
+      return;
+    }
+  }
+  // a block of neighbouring chunks per queue, so threads start on their own work and only steal at the end
+  const size_t perQueue = (chunks + queues_.size() - 1) / queues_.size();
+  Job block[64];
+  for (size_t q = 0; q < queues_.size(); ++q) {
+    const size_t first = q * perQueue;
+    const size_t last = min(first + perQueue, chunks);
+    for (size_t c = first; c < last;) {
+      size_t n = 0;
+      for (; c < last && n < 64; ++c, ++n) {
+        block[n] = job;
+        block[n].begin = c * grain;
+        block[n].end = min(block[n].begin + grain, count);
+      }
+      Push(q, block, n);
+    }
+  }
+}
+
+void JobPool::Wait(JobCounter &counter) {
+  const size_t queue = OwnQueue();
+  while (!counter.Done()) {
+    if (!RunOne(queue)) {
+      this_thread::yield();
+    }
+  }
+  // the thread that finished the last job may still be releasing the jobs waiting on the counter
+  lock_guard<mutex> lock(counter.mutex_);
+}
+
+void JobPool::WorkerLoop(size_t queue) {
+  workerPool = this;
+  workerQueue = queue;
+  for (;;) {
+    if (RunOne(queue)) {
+      continue;
+    }
+    unique_lock<mutex> lock(sleepMutex_);
+    wake_.wait(lock, [this]() { return quit_ || queued_ > 0; });
+    if (quit_) {
+      return;
+    }
+  }
+}
+
+static unique_ptr<JobPool> pool;
+
+JobPool &GetJobPool() {
+  if (!pool) {
+    SetWorkerCount(0);
+  }
+  return *pool;
+}
+
+void SetWorkerCount(size_t threads) {
+  if (threads == 0) {
+    threads = thread::hardware_concurrency();
+    threads = threads ? threads : 1;
+  }
+  const bool deterministic = pool && pool->Deterministic();
+  pool.reset();
+  pool.reset(new JobPool(threads));
+  pool->SetDeterministic(deterministic);
+}
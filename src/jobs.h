@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobPool;
+
+//Jobs of a group that haven't finished yet. Jobs submitted to run after a counter start once it reaches zero,
+//and waiting on a counter runs other jobs in the meantime instead of blocking.
+class JobCounter {
+public:
+  JobCounter() : pending_(0) {}
+  bool Done() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+private:
+  friend class JobPool;
+  struct Job {
+    typedef void (*Fn)(const void *ctx, size_t begin, size_t end);
+    //ranges of a parallel loop call fn, single jobs call task
+    Fn fn;
+    void (*task)(void *data);
+    const void *ctx;
+    void *data;
+    size_t begin, end;
+    JobCounter *done;
+  };
+  JobCounter(const JobCounter &);
+  JobCounter &operator=(const JobCounter &);
+
+  std::atomic<uint32_t> pending_;
+  //jobs waiting for this counter to reach zero
+  std::mutex mutex_;
+  std::vector<Job> waiting_;
+};
+
+//Work-stealing pool of worker threads. Every thread has its own queue: it takes its newest job first, and when
+//the queue is empty it steals the oldest job of another one. Threads that aren't workers (the main thread, the
+//simulation thread) share an extra queue, and take part in the work whenever they wait on a counter.
+//In deterministic mode stages that gather results from several jobs put them together in a fixed order, so a run
+//gives the same result bit for bit whatever the number of threads.
+class JobPool {
+public:
+  typedef JobCounter::Job Job;
+  typedef void (*TaskFn)(void *data);
+
+  //threads includes the calling thread
+  explicit JobPool(size_t threads);
+  ~JobPool();
+  size_t Size() const { return workers_.size() + 1; }
+
+  void SetDeterministic(bool deterministic) { deterministic_ = deterministic; }
+  bool Deterministic() const { return deterministic_; }
+
+  //runs task(data) once after has no pending jobs (right away if null), done counts it until it has finished
+  void Submit(TaskFn task, void *data, JobCounter &done, JobCounter *after = nullptr);
+  //starts fn(begin, end) over [0, count) in chunks of grain indices, done counts the chunks.
+  //fn must stay alive until done reaches zero.
+  template <typename F> void Dispatch(size_t count, size_t grain, const F &fn, JobCounter &done, JobCounter *after = nullptr) {
+    Spread(count, grain, &invokeRange<F>, &fn, done, after);
+  }
+  //runs jobs until counter reaches zero
+  void Wait(JobCounter &counter);
+  //calls fn(begin, end) over [0, count) in chunks of grain indices and returns once all chunks are done.
+  //fn may start parallel loops itself, the thread waiting on them keeps running jobs.
+  template <typename F> void ParallelFor(size_t count, size_t grain, const F &fn) {
+    grain = grain ? grain : 1;
+    // not worth waking anyone up for a single chunk
+    if (workers_.empty() || count <= grain) {
+      if (count) {
+        fn(size_t(0), count);
+      }
+      return;
+    }
+    JobCounter done;
+    Dispatch(count, grain, fn, done);
+    Wait(done);
+  }
+  //number of chunks of grain indices in count
+  static size_t Chunks(size_t count, size_t grain) { return grain ? (count + grain - 1) / grain : count; }
+
+  //jobs run and jobs taken from another thread's queue since the pool started
+  uint64_t JobsRun() const { return jobsRun_; }
+  uint64_t JobsStolen() const { return jobsStolen_; }
+
+private:
+  template <typename F> static void invokeRange(const void *ctx, size_t begin, size_t end) {
+    (*static_cast<const F *>(ctx))(begin, end);
+  }
+  //one thread's jobs: the owner pushes and pops at the back, thieves take from the front
+  struct Queue {
+    std::mutex mutex;
+    std::vector<Job> jobs;
+    size_t head;
+    Queue() : head(0) {}
+  };
+
+  void Spread(size_t count, size_t grain, Job::Fn fn, const void *ctx, JobCounter &done, JobCounter *after);
+  void Push(size_t queue, const Job *jobs, size_t count);
+  bool Pop(size_t queue, Job &job);
+  bool Steal(size_t queue, Job &job);
+  bool RunOne(size_t queue);
+  void Finish(const Job &job, size_t queue);
+  size_t OwnQueue() const;
+  void WorkerLoop(size_t queue);
+
+  std::vector<std::thread> workers_;
+  //queue 0 is shared by every thread that isn't a worker, worker i owns queue i + 1
+  std::vector<std::unique_ptr<Queue>> queues_;
+  //jobs sitting in a queue, workers sleep while there are none
+  std::atomic<size_t> queued_;
+  std::mutex sleepMutex_;
+  std::condition_variable wake_;
+  bool quit_;
+  bool deterministic_;
+  std::atomic<uint64_t> jobsRun_;
+  std::atomic<uint64_t> jobsStolen_;
+};
+
+//pool shared by the physics stages, sized to the hardware threads unless changed
+JobPool &GetJobPool();
+//recreates the shared pool with the given number of threads (0 = hardware threads), keeping its mode
+void SetWorkerCount(size_t threads);
@@ -1,5 +1,9 @@
 #define GLM_ENABLE_EXPERIMENTAL
+#include "cloth.h"
+#include "clothmesh.h"
 #include "physics.h"
+#include "pipeline.h"
+#include "scheduler.h"
 #include <glm/glm.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <graphics_framework.h>
@@ -11,8 +15,12 @@ using namespace std;
 using namespace graphics_framework;
 using namespace glm;
 
-//defining physics_tick
-#define physics_tick 1.0f / 60.0f
+//physics runs at 60 ticks per second, catching up at most 5 ticks after a slow frame
+static FixedStepScheduler scheduler(60.0, 1, 5);
+//physics runs on its own thread, the main thread draws the last snapshot it published
+static SimPipeline pipeline(scheduler);
+//title values carried by the snapshots
+enum { TITLE_MASS, TITLE_GRAVITY, TITLE_STIFFNESS, TITLE_SOLVER, TITLE_ASLEEP, TITLE_VALUES };
 
 //Camera variables
 double xpos = 0.0f;
@@ -21,274 +29,24 @@ free_camera free_cam;
 //boolean to determine if free camera is active
 bool isCam = false;
 
-//Vectors containing particles and springs of the cloth
-static vector<unique_ptr<Entity>> ClothParticles;
-static vector<cSpring> springList;
-
 //floor entity
 static unique_ptr<Entity> floorEnt;
 
-//cloth is composed of 15x15 particles
-int rows = 15;
-//Springs and damper constants 
-float stretchConstant = 95.0f;
-float shearConstant = 90.0f;
-float bendingConstant = 80.0f;
-float diagonalBendingConstant = 20.0f;
-float dampingFactor = 90.0f;
-//natural length of the cloth set to distance between particles
-float naturalLength = 0.3f;
-
 //default wind direction is 0
 vec3 windDir = vec3(0.0f, 0.0f, 0.0f);
 //boolean to determine if wind is active
 bool isWindActive = false;
+//boolean to switch the solver once per press of P
+bool isSolverKeyDown = false;
 
 //boolean to determine if the particles are rendered - for graphical purposes only
 bool isRendered = false;
-//vector containing positions to create cloth grid
-vector<glm::vec3> grid;
-
-
-//method to create the cloth particles at a given position and with a given mass 
-unique_ptr<Entity> CreateParticle(float xPos, float yPos, float zPos, double myMass) {
-	//creates new entity
-	unique_ptr<Entity> ent(new Entity());
-	//set position at passed values to the method
-	ent->SetPosition(vec3(xPos, yPos, zPos));
-	//creating new cPhysics, that will contain all the particle physics
-	cPhysics *phys = new cPhysics();
-	//set mass to given mass
-	phys->mass = myMass;
-	//creating new component using cPhysics created before
-	unique_ptr<Component> physComponent(phys);
-	//rendering the particles as spheres
-	unique_ptr<cShapeRenderer> renderComponent(new cShapeRenderer(cShapeRenderer::SPHERE));
-	//choosing a random colour for particle
-	renderComponent->SetColour(phys::RandomColour());
-	//adding the component created to the entity
-	ent->AddComponent(physComponent);
-	//creating a new sphere collider for the particle
-	cSphereCollider *coll = new cSphereCollider();
-	//setting collider radius to 0.3
-	coll->radius = 0.03f;
-	//adding remaining components to the entity
-	ent->AddComponent(unique_ptr<Component>(coll));
-	ent->AddComponent(unique_ptr<Component>(move(renderComponent)));
-	//returning entity
-	return ent;
-}
-
-//Method to get specific particle in the list of Cloth Particles, based on its cartesian coordinates 
-cPhysics *getParticle(int x, int z)
-{
-	//casting particles from Entity to cPhysics (to get particles attributes) and converting its coordinates into correct index in the list like:
-	//(rows = 16) if coordinates of the particle are (1 , 3), its index will be : 1 * 15 + 3 = 18. 
-	auto p = static_cast<cPhysics *>(ClothParticles[x * rows + z]->GetComponents("Physics")[0]);
-	return p;
-}
-
-//Method to get specific spring in the list of Cloth springs, based on its cartesian coordinates
-cSpring getSpring(int x, int z)
-{
-	//converts spring's coordinate into its index inside the list of springs
-	auto spring = springList[x * rows + z];
-	return spring;
-}
-
-//Method to generate the cloth, creating particles and putting them in a grid layout nad inserting them into the list of particles
-void Cloth()
-{
-	//looping through x axis
-	for (int x = 0; x < rows; x++)
-	{
-		//looping through z axys
-		for (int z = 0; z < rows; z++)
-		{
-			//creating particle based on x and z value (using a distance of 0.3)
-			unique_ptr<Entity> particle = CreateParticle(x*0.3f, 10.0f, (z - 10.0f)*0.3f, 1.0f);
-			//pushing it into the vector containing all particles
-			ClothParticles.push_back(move(particle));
-		}
-	}
-}
-
-//method to update the cloth, creating springs between particles
-void updateCloth()
-{
-	//clearing the list of spring every time update is called
-	springList.clear();
-
-	//looping through x and z axis
-	for (int x = 0; x < rows; x++)
-	{
-		for (int z = 0; z < rows; z++)
-		{
-			//*********Structural (horizontal and vertical) and Shear (diagonal) springs*********//
-
-			//if the particle is at a margin of the z axis
-			if (z == (rows - 1))
-			{
-				//if x + 1 is different from the maximum number allowed (rows number)
-				if (x + 1 != rows)
-				{
-					//create only horizontal structural spring
-					//get the current particle and link it to the next one, using appropriate spring constants and setting colour
-					cSpring aa = cSpring(getParticle(x + 1, z), getParticle(x, z), stretchConstant, naturalLength, dampingFactor, BLUE);
-					//updating the spring
-					aa.update();
-					//
-					springList.push_back(aa);
-				}
-			}
-			//if the particle is at a margin of the x axis
-			else if (x == (rows - 1))
-			{
-				//if z + 1 is different from the maximum number allowed (rows number)
-				if (z + 1 != rows)
-				{
-					//vertical structural spring
-					//get the current particle and link it to the next one, using appropriate spring constants and setting colour
-					cSpring aa = cSpring(getParticle(x, z + 1), getParticle(x, z), stretchConstant, naturalLength, dampingFactor, BLUE);
-					aa.update();
-					springList.push_back(aa);
-				}
-			}
-			//if z + 1 and x + 1 are different from the maximum number allowed (rows number)
-			else if (x != (rows - 1) && z != (rows - 1))
-			{
-				//then every type of spring can be created..
-
-				//creating diagonal shear spring
-				//get the current particle and link it to the next one. Since it is diagonal, to keep the same distance, the natural length of the spring
-				//is set to the diagonal of the square created by the 4 particles where the current particle is
-				cSpring aa = cSpring(getParticle(x + 1, z + 1), getParticle(x, z), shearConstant, (naturalLength * sqrt(2.0)), dampingFactor, GREEN);
-				aa.update();
-				springList.push_back(aa);
-				//vertical structural spring
-				aa = cSpring(getParticle(x, z + 1), getParticle(x, z), stretchConstant, naturalLength, dampingFactor, BLUE);
-				aa.update();
-				springList.push_back(aa);
-				//horizontal structural spring
-				aa = cSpring(getParticle(x + 1, z), getParticle(x, z), stretchConstant, naturalLength, dampingFactor, BLUE);
-				aa.update();
-				springList.push_back(aa);
-			}
-			//if x is more than 0 and z is less than the last row
-			if (x > 0 && z < (rows - 1))
-			{
-			//create reverse diagonal shear spring
-			cSpring aa = cSpring(getParticle(x - 1, z + 1), getParticle(x, z), shearConstant, (naturalLength * sqrt(2.0)), dampingFactor, GREEN);
-			aa.update();
-			springList.push_back(aa);
-			}
+//cloth grid mesh, its positions are streamed from the snapshot every frame
+ClothMesh clothMesh;
+//colour of every cloth particle in cloth order, and their centres this frame, drawn as one batch of spheres
+vector<phys::RGBAInt32> particleColours;
+vector<glm::vec3> particleCentres;
 
-			//Bending springs (vertical, horizontal and diagonal springs every two particle)
-
-			//if z + 2 doesn't go outside the cloth
-				if (z + 2 < rows)
-				{
-					//vertical bending spring
-					cSpring aa = cSpring(getParticle(x, z + 2), getParticle(x, z), bendingConstant, naturalLength * 2, dampingFactor, RED);
-					aa.update();
-					springList.push_back(aa);
-				}
-				//if x + 2 doesn't go outside the cloth
-				if (x + 2 < rows)
-				{
-					//horizontal bending spring
-					cSpring	aa = cSpring(getParticle(x + 2, z), getParticle(x, z), bendingConstant, naturalLength * 2.0, dampingFactor, RED);
-					aa.update();
-					springList.push_back(aa);
-				}
-				//check if both x + 2 and z + 2 don't go outside the cloth
-				if (x + 2 < rows && z + 2 < rows)
-				{
-					//diagonal bending spring, using diagonal of the square of paricles, multiplied by 2 since bending spring is created every 2 particle
-					cSpring aa = cSpring(getParticle(x + 2, z + 2), getParticle(x, z), diagonalBendingConstant, (naturalLength * sqrt(2.0)) * 2, dampingFactor, RED);
-					aa.update();
-					springList.push_back(aa);
-				}
-				//check if both x - 2 and z + 2 don't go outside the cloth
-				if (x - 2 > 0 && z + 2 < rows)
-				{
-					//diagonal bending spring
-					cSpring aa = cSpring(getParticle(x - 1, z + 1), getParticle(x, z), diagonalBendingConstant, (naturalLength * sqrt(2.0)) * 3, dampingFactor, RED);
-					aa.update();
-					springList.push_back(aa);
-				}
-		}
-	}
-}
-
-//Method to generate the wind in a given direction
-void generateWind(const vec3 direction)
-{
-	//calculate wind for every particle
-	for (auto &e : ClothParticles) {
-		//add a randomness to every particle to make wind more realistic (multiplied by 4)
-		float random = ((float)rand() / RAND_MAX) * 4.0f;
-		//casting particles from Entity to cPhysics (to get particles attributes)
-		auto p = static_cast<cPhysics *>(e->GetComponents("Physics")[0]);
-		//windforce is the wind direction by the random factor
-		vec3 windForce = direction  * random;
-		//adding wind to particle as a force
-		p->AddImpulse(windForce);
-	}
-}
-
-//for testing - Fixes top row of the cloth, setting those particles position to their previous (starting) position and make them fixed, setting the bool to true
-void fixTopRow()
-{
-	//Starting from (0, 4) position
-	int z = rows - 1;
-	int x = 0;
-	//loops the particle position until the row is finished
-	while (x < rows)
-	{
-		//set particle position to prev position
-		getParticle(x, z)->position = getParticle(x, z)->prev_position;
-		//set bool to true, so the particles are not rendered anymore
-		getParticle(x, z)->fixed = true;
-		//increment x axis
-		x++;
-	}
-}
-
-//for testing - Fixes bottom row of the cloth, setting those particles position to their previous (starting) position and make them fixed, setting the bool to true
-void fixBottomRow()
-{
-	//Starting from (0, 0) position
-	int z = 0;
-	int x = 0;
-	//loops the particle position until the row is finished
-	while (x < rows)
-	{
-		//set particle position to prev position
-		getParticle(x, z)->position = getParticle(x, z)->prev_position;
-		//set bool to true, so the particles are not rendered anymore
-		getParticle(x, z)->fixed = true;
-		//increment x axis
-		x++;
-	}
-}
-
-//Method to fix the corners of the cloth - works like fixBottomRow and fixTopRow
-void fixCorners()
-{
-	//get the particle at (0, 0) coordinates and set it to previous position, to make it fixed and to not render itanymore
-	getParticle(0, 0)->position = getParticle(0, 0)->prev_position;
-	getParticle(0, 0)->fixed = true;
-
-	getParticle(0, rows - 1)->position = getParticle(0, rows - 1)->prev_position;
-	getParticle(0, rows - 1)->fixed = true;
-
-	getParticle(rows - 1, 0)->position = getParticle(rows - 1, 0)->prev_position;
-	getParticle(rows - 1, 0)->fixed = true;
-
-	getParticle(rows - 1, rows - 1)->position = getParticle(rows - 1, rows - 1)->prev_position;
-	getParticle(rows - 1, rows - 1)->fixed = true;
-}
 
 //FPS Counter in the top bar of the window, using GLFM | from http://r3dux.org/  --> I'm keeping almost all original comments of the creator
 double calcFPS(double theTimeInterval = 1.0, std::string windowTitle = "NONE")
@@ -334,160 +92,32 @@ double calcFPS(double theTimeInterval = 1.0, std::string windowTitle = "NONE")
 	return fps;
 }
 
-//Method to add mass to every particle in the cloth
-void addMass()
+//one physics tick of the cloth, run by the scheduler on the simulation thread
+static void clothStep(double t, double dt)
 {
-	//Particle
-	cPhysics *p;
-
-	//for every Entity in ClothParticles
-	for (auto &e : ClothParticles) {
-		//casting particles from Entity to cPhysics (getting particles attributes)
-		p = static_cast<cPhysics *>(e->GetComponents("Physics")[0]);
-		//checking if mass doesn't go over safe value (30)
-		if (p->mass < 30.0)
-			//increase mass
-			p->mass += 0.05;
-	}
-
-	//for testing only - can be commented out
-	p = static_cast<cPhysics *>(ClothParticles[15]->GetComponents("Physics")[0]); //
-	cout << "Cloth mass is: " << p->mass;										  //
-}
-
-//Method to remove mass to every particle in the cloth
-void removeMass()
-{
-	//Particle
-	cPhysics *p;
-
-	//for every Entity in ClothParticles
-	for (auto &e : ClothParticles) {
-		//casting particles from Entity to cPhysics (getting particles attributes)
-		p = static_cast<cPhysics *>(e->GetComponents("Physics")[0]);
-		//checking if mass doesn't go ower than safe value (1)
-		if (p->mass > 1.0)
-			//decrease mass
-			p->mass -= 0.05;
-	}
-
-	//for testing only - can be commented out
-	p = static_cast<cPhysics *>(ClothParticles[15]->GetComponents("Physics")[0]); //
-	cout << "Cloth mass is: " << p->mass;
-}
-
-//Method to increase gravity
-void increaseGravity()
-{
-	//Particle
-	cPhysics *p;
-
-	//for every Entity in ClothParticles
-	for (auto &e : ClothParticles) {
-		//casting particles from Entity to cPhysics (getting particles attributes)
-		p = static_cast<cPhysics *>(e->GetComponents("Physics")[0]);
-		//checking if mass doesn't go over safe value (-40)
-		if (p->gravity.y > -40.0)
-			//increase gravity (in a negative direction)
-			p->gravity.y -= 0.1;
-	}
-
-	//for testing only - can be commented out
-	p = static_cast<cPhysics *>(ClothParticles[15]->GetComponents("Physics")[0]);
-	cout << "Gravity is: " << p->gravity.y;
-}
-
-//Method to decrease gravity
-void decreaseGravity()
-{
-	//Particle
-	cPhysics *p;
-
-	//for every Entity in ClothParticles
-	for (auto &e : ClothParticles) {
-		//casting particles from Entity to cPhysics (getting particles attributes)
-		p = static_cast<cPhysics *>(e->GetComponents("Physics")[0]);
-		//checking if mass doesn't go lower than safe value (-1)
-		if (p->gravity.y < -1.0)
-			//decrease gravity (in a positive direction)
-			p->gravity.y += 0.1;
-	}
-	//for testing only - can be commented out
-	p = static_cast<cPhysics *>(ClothParticles[15]->GetComponents("Physics")[0]);
-	cout << "Gravity is: " << p->gravity.y;
-}
-
-//Get stiffness average of the cloth, to show the value to the user
-double getAverageStiffness()
-{
-	//initializing average
-	double average = 0.0;
-	//adding all spring constants to average
-	average += stretchConstant;
-	average += shearConstant;
-	average += bendingConstant;
-	average += diagonalBendingConstant;
-	//dividing the average by 4 (number of spring constants defined)
-	average /= 4.0;
-
-	//return average
-	return average;
+	UpdatePhysics(t, dt);
+	//calling the method to fix the corners of the cloth
+	fixCorners();
 }
 
-//Method to increase stiffness of the cloth, modifing springs constants
-void increaseStiffness()
+//copying the values shown in the title into the snapshot, on the simulation thread
+static void captureTitle(Snapshot &snapshot)
 {
-	//increment constant of 0.3 only if the highest constant is less than 95.0 (safe value tested)
-	if (stretchConstant < 95.0f)
-	{
-		//incrementing constants and damping factor
-		stretchConstant += 0.3f;
-		shearConstant += 0.3f;
-		bendingConstant += 0.3f;
-		diagonalBendingConstant += 0.3f;
-		dampingFactor += 0.3f;
-	}
-	else if (stretchConstant < 97.0 && stretchConstant > 93.0f)
-	{
-		stretchConstant = 95.0f;
-		shearConstant = 90.0f;
-		bendingConstant = 80.0f;
-		diagonalBendingConstant = 20.0f;
-		dampingFactor = 90.0f;
-	}
+	snapshot.values.resize(TITLE_VALUES);
+	snapshot.values[TITLE_MASS] = ClothParticles[15]->getComponent<cPhysics>()->GetMass();
+	snapshot.values[TITLE_GRAVITY] = GetParticles().gravity.y;
+	snapshot.values[TITLE_STIFFNESS] = getAverageStiffness();
+	snapshot.values[TITLE_SOLVER] = GetSolver();
+	snapshot.values[TITLE_ASLEEP] = static_cast<double>(clothSleep.Stats().sleepingParticles);
 }
 
-//Method to decrease stiffness of the cloth, modifing springs constants
-void decreaseStiffness()
+//Method to set the title of the window and updating information about the simulation
+void setTitle(const Snapshot &snapshot)
 {
-	//checking that every spring constand and damper doesn't go lower than  agiven safe value
-
-	if (diagonalBendingConstant > 1.0f)
+	if (snapshot.values.size() < TITLE_VALUES)
 	{
-		//decreasing the spring constant if not lower than 1
-		diagonalBendingConstant -= 0.3f;
+		return;
 	}
-	if (stretchConstant > 20.0f)
-	{
-		//decreasing the spring constant if not lower than 20
-		stretchConstant -= 0.3f;
-		//damping factos should ideally be really similar to stretch constrant
-		dampingFactor -= 0.3f;
-	}
-	if (stretchConstant > 20.0f)
-	{
-		shearConstant -= 0.3f;
-	}
-	if (bendingConstant > 20.0f)
-	{
-		bendingConstant -= 0.3f;
-	}
-}
-
-//Method to set the title of the window and updating information about the simulation
-void setTitle()
-{
-	auto p = static_cast<cPhysics *>(ClothParticles[15]->GetComponents("Physics")[0]);
 	//string to be concatenated
 	stringstream ss;
 	string wind = "";
@@ -501,9 +131,11 @@ void setTitle()
 		wind = "No";
 	}
 	//concatenation info for the title, updating in real time
-	ss << "Physics Simulation Cloth ---> (M) Cloth mass is now: " << p->mass << " | (G) Gravity is: " << p->gravity.y << " | (S) Average Stiffnes is: " 
-		<< getAverageStiffness() << " | (Z-X) Wind activated: " << wind << " | (C) Wind force: " 
-		<< windDir.y << " | (C) Wind direction: " << windDir.x;
+	ss << "Physics Simulation Cloth ---> (M) Cloth mass is now: " << snapshot.values[TITLE_MASS] << " | (G) Gravity is: " << snapshot.values[TITLE_GRAVITY] << " | (S) Average Stiffnes is: " 
+		<< snapshot.values[TITLE_STIFFNESS] << " | (Z-X) Wind activated: " << wind << " | (C) Wind force: " 
+		<< windDir.y << " | (C) Wind direction: " << windDir.x << " | (P) Solver: "
+		<< SolverName(static_cast<SolverKind>(static_cast<int>(snapshot.values[TITLE_SOLVER])))
+		<< " | Asleep: " << snapshot.values[TITLE_ASLEEP] << "/" << ClothParticles.size();
 	//casting the stringstream to string
 	string s = ss.str();
 	calcFPS(1.0, s);        //updates window title with fps and other values
@@ -512,26 +144,7 @@ void setTitle()
 
 //update method
 bool update(float delta_time) {
-	static float t = 0.0;
-	static float accumulator = 0.0;
-	accumulator += delta_time;
-
-	//definind time for executing all the physics calculations
-	while (accumulator > physics_tick) {
-		UpdatePhysics(t, physics_tick);
-		accumulator -= physics_tick;
-		t += physics_tick;
-	}
-
-	//update every particle in the cloth
-	for (auto &e : ClothParticles) {
-		e->Update(delta_time);
-	}
-
-	//calling the method to fix the corners of the cloth
-	fixCorners();
-	//calling method to update the springs of the cloth
-	updateCloth();
+	//the physics ticks on its own thread, everything below that changes the cloth is posted to it
 	
 	//***********************************************Camera Controls***********************************************//
 
@@ -600,8 +213,9 @@ bool update(float delta_time) {
 	//if wind is active, keep the flow of window active
 	if (isWindActive == true && glfwGetKey(renderer::get_window(), GLFW_KEY_Z) == GLFW_RELEASE)
 	{
-		//calling generate wind method 
-		generateWind(windDir);
+		//calling generate wind method on the simulation thread, with the current direction
+		const vec3 direction = windDir;
+		pipeline.Post([direction]() { generateWind(direction); });
 	}
 
 	//button to activate wind
@@ -685,6 +299,22 @@ bool update(float delta_time) {
 		}
 	}
 
+	//****SOLVER****//
+
+	//if P is pressed, switch to the next solver: spring forces, XPBD, implicit, multigrid (only once until it is released)
+	if (glfwGetKey(renderer::get_window(), GLFW_KEY_P))
+	{
+		if (isSolverKeyDown == false)
+		{
+			isSolverKeyDown = true;
+			pipeline.Post([]() { SetSolver(static_cast<SolverKind>((GetSolver() + 1) % SOLVER_KINDS)); });
+		}
+	}
+	else
+	{
+		isSolverKeyDown = false;
+	}
+
 	//****MASS****//
 
 	//if M is pressed
@@ -694,13 +324,13 @@ bool update(float delta_time) {
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_UP))
 		{
 			//calling method to add mass
-			addMass();
+			pipeline.Post(addMass);
 		}
 		//if DOWN is pressed while M is down
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_DOWN))
 		{
 			//calling method to remove mass
-			removeMass();
+			pipeline.Post(removeMass);
 		}
 	}
 
@@ -713,13 +343,13 @@ bool update(float delta_time) {
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_UP))
 		{
 			//calling method to increase gravity
-			increaseGravity();
+			pipeline.Post(increaseGravity);
 		}
 		//if DOWN is pressed while G is down
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_DOWN))
 		{
 			//calling method to decrease gravity
-			decreaseGravity();
+			pipeline.Post(decreaseGravity);
 		}
 	}
 
@@ -732,18 +362,18 @@ bool update(float delta_time) {
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_UP))
 		{
 			//calling method to increase the stiffness
-			increaseStiffness();
+			pipeline.Post(increaseStiffness);
 		}
 		//if DOWN is pressed while S is down
 		if (glfwGetKey(renderer::get_window(), GLFW_KEY_DOWN))
 		{
 			//calling method to decrease the stiffness
-			decreaseStiffness();
+			pipeline.Post(decreaseStiffness);
 		}
 	}
 
-	//calling set title to update values
-	setTitle();
+	//calling set title to update values, from the newest snapshot
+	setTitle(pipeline.Latest());
 
 	//set camera to false when F is not pressed
 	isCam = false;
@@ -763,6 +393,19 @@ bool load_content() {
 
 	//calling method to create cloth particles
 	Cloth();
+	//rendering the particles as spheres, choosing a random colour for every particle
+	for (auto &e : ClothParticles) {
+		unique_ptr<cShapeRenderer> renderComponent(new cShapeRenderer(cShapeRenderer::SPHERE));
+		renderComponent->SetColour(phys::RandomColour());
+		particleColours.push_back(renderComponent->GetColour());
+		e->AddComponent(unique_ptr<Component>(move(renderComponent)));
+	}
+	//the grid vertices are the cloth particles in order, each one reading its particle's slot
+	vector<uint32_t> slots;
+	for (auto &e : ClothParticles) {
+		slots.push_back(static_cast<uint32_t>(e->getComponent<cPhysics>()->index));
+	}
+	clothMesh.SetGrid(rows, slots.data());
 
 	//creating new entity plane
 	floorEnt = unique_ptr<Entity>(new Entity());
@@ -778,32 +421,42 @@ bool load_content() {
 
 	InitPhysics();
 
+	//starting the physics thread, ticking the cloth and publishing the title values with every snapshot
+	scheduler.SetStep(clothStep);
+	pipeline.SetCapture(captureTitle);
+	pipeline.Start();
+
 	return true;
 }
 
 bool render() {
+	//newest state of the physics, it doesn't change while it is drawn
+	const Snapshot &snapshot = pipeline.Latest();
+	const float alpha = pipeline.Alpha(snapshot);
 
 	//if space bar is pressed, boolean is true and then renders the particles
-	if (isRendered)
+	if (isRendered && ClothParticles.size() == particleColours.size())
 	{
-		for (auto &e : ClothParticles) {
-			e->Render();
+		particleCentres.resize(ClothParticles.size());
+		for (size_t i = 0; i < ClothParticles.size(); ++i) {
+			const size_t slot = ClothParticles[i]->getComponent<cPhysics>()->index;
+			particleCentres[i] = slot < snapshot.positions.size() ? snapshot.Position(slot, alpha) : vec3(0.0f);
 		}
+		//all the particles in one instanced draw
+		phys::DrawSpheres(particleCentres.data(), particleCentres.size(), 0.05f, particleColours.data());
 	}
 
 	//drawing the scene
 	phys::DrawScene();
 
-	//clearing the grid positions to update it in real time
-	grid.clear();
+	//the grid reads the cloth positions from the snapshot, interpolated between ticks, while it is streamed
+	clothMesh.SetPositions(snapshot.previous.data(), snapshot.positions.data(), snapshot.positions.size(), alpha);
 
-	//setting grid position as cloth particles positions
-	for (auto &e : ClothParticles) {
-		grid.push_back(e->GetPosition());
-	}
+	//drawing the grid as a wireframe in structure mode, and as a lit surface with its normals otherwise
+	phys::DrawGrid(clothMesh, isRendered ? phys::wireframe : phys::solid);
 
-	//drawing the grid as a wireframe
-	phys::DrawGrid(&grid[0], rows*rows, rows, phys::wireframe);
+	//drawing the spheres and lines recorded this frame
+	phys::FlushDebugDraw();
 
 	return true;
 }
@@ -817,5 +470,7 @@ void main() {
 	application.set_render(render);
 	// Run application
 	application.run();
+	//stopping the physics thread before the cloth goes away
+	pipeline.Stop();
 }
 
@@ -0,0 +1,261 @@
+#include "multigrid.h"
+#include <algorithm>
+
+using namespace std;
+
+//rows per job on every level
+static const size_t rowGrain = 2048;
+//levels at most, a grid is halved each time so this is far more than any cloth needs
+static const size_t maxLevels = 16;
+//grids with fewer rows are not worth coarsening again
+static const size_t minRows = 5;
+//Jacobi sweeps before and after the coarse correction, on the coarsest level, and their damping
+static const int smoothSweeps = 2;
+static const int coarseSweeps = 10;
+static const float jacobiWeight = 2.0f / 3.0f;
+
+//coarse rows (up to 2) and weights a fine row x of the grid is interpolated from, coarse row X is fine row 2 X
+static size_t interpolation(size_t x, size_t coarseRows, uint32_t *rows, float *weights) {
+  if (x % 2 == 0) {
+    rows[0] = static_cast<uint32_t>(x / 2);
+    weights[0] = 1.0f;
+    return 1;
+  }
+  rows[0] = static_cast<uint32_t>(x / 2);
+  // the last row of an even grid has no kept row after it
+  if (x / 2 + 1 >= coarseRows) {
+    weights[0] = 1.0f;
+    return 1;
+  }
+  rows[1] = rows[0] + 1;
+  weights[0] = weights[1] = 0.5f;
+  return 2;
+}
+
+ClothMultigrid::ClothMultigrid() {}
+
+void ClothMultigrid::Clear() { levels_.clear(); }
+
+void ClothMultigrid::Build(const BlockSparseMatrix &a, uint32_t first, size_t rows) {
+  Clear();
+  const size_t count = a.Rows();
+  if (rows < minRows || first + rows * rows > count) {
+    return;
+  }
+  // levels hold pointers into each other's arrays while they are built, they must not move
+  levels_.reserve(maxLevels);
+  levels_.push_back(Level());
+  levels_[0].t.resize(3 * count);
+  const BlockSparseMatrix *fineMatrix = &a;
+  size_t fineRows = rows, fineCount = count;
+  uint32_t fineFirst = first;
+  vector<uint32_t> columns;
+  while (fineRows >= minRows && levels_.size() < maxLevels) {
+    const size_t coarseRows = (fineRows + 1) / 2;
+    const size_t grid = fineRows * fineRows;
+    const size_t coarseCount = coarseRows * coarseRows + fineCount - grid;
+    Level &fine = levels_.back();
+    // prolongation, bilinear over the grid and one to one for the rest
+    fine.pStart.resize(fineCount + 1);
+    fine.pColumn.clear();
+    fine.pWeight.clear();
+    uint32_t extra = static_cast<uint32_t>(coarseRows * coarseRows);
+    for (size_t i = 0; i < fineCount; ++i) {
+      fine.pStart[i] = static_cast<uint32_t>(fine.pColumn.size());
+      if (i < fineFirst || i >= fineFirst + grid) {
+        fine.pColumn.push_back(extra++);
+        fine.pWeight.push_back(1.0f);
+        continue;
+      }
+      uint32_t xs[2], zs[2];
+      float xw[2], zw[2];
+      const size_t nx = interpolation((i - fineFirst) / fineRows, coarseRows, xs, xw);
+      const size_t nz = interpolation((i - fineFirst) % fineRows, coarseRows, zs, zw);
+      for (size_t u = 0; u < nx; ++u) {
+        for (size_t v = 0; v < nz; ++v) {
+          fine.pColumn.push_back(static_cast<uint32_t>(xs[u] * coarseRows + zs[v]));
+          fine.pWeight.push_back(xw[u] * zw[v]);
+        }
+      }
+    }
+    fine.pStart[fineCount] = static_cast<uint32_t>(fine.pColumn.size());
+    // restriction is the transpose, by coarse row, with the fine rows in order
+    fine.rStart.assign(coarseCount + 1, 0);
+    for (uint32_t c : fine.pColumn) {
+      ++fine.rStart[c + 1];
+    }
+    for (size_t c = 0; c < coarseCount; ++c) {
+      fine.rStart[c + 1] += fine.rStart[c];
+    }
+    fine.rColumn.resize(fine.pColumn.size());
+    fine.rWeight.resize(fine.pColumn.size());
+    vector<uint32_t> next(fine.rStart.begin(), fine.rStart.end() - 1);
+    for (size_t i = 0; i < fineCount; ++i) {
+      for (uint32_t p = fine.pStart[i]; p < fine.pStart[i + 1]; ++p) {
+        const uint32_t to = next[fine.pColumn[p]]++;
+        fine.rColumn[to] = static_cast<uint32_t>(i);
+        fine.rWeight[to] = fine.pWeight[p];
+      }
+    }
+    // pattern of R A P: coarse row I reaches every coarse node interpolating a neighbour of a fine node it restricts
+    Level coarse;
+    BlockSparseMatrix &m = coarse.matrix;
+    m.rowStart.resize(coarseCount + 1);
+    coarse.diagonal.resize(coarseCount);
+    for (size_t c = 0; c < coarseCount; ++c) {
+      columns.clear();
+      for (uint32_t k = fine.rStart[c]; k < fine.rStart[c + 1]; ++k) {
+        const uint32_t i = fine.rColumn[k];
+        for (uint32_t s = fineMatrix->rowStart[i]; s < fineMatrix->rowStart[i + 1]; ++s) {
+          const uint32_t j = fineMatrix->column[s];
+          columns.insert(columns.end(), fine.pColumn.begin() + fine.pStart[j], fine.pColumn.begin() + fine.pStart[j + 1]);
+        }
+      }
+      sort(columns.begin(), columns.end());
+      columns.erase(unique(columns.begin(), columns.end()), columns.end());
+      m.rowStart[c] = static_cast<uint32_t>(m.column.size());
+      coarse.diagonal[c] =
+          m.rowStart[c] + static_cast<uint32_t>(lower_bound(columns.begin(), columns.end(), c) - columns.begin());
+      m.column.insert(m.column.end(), columns.begin(), columns.end());
+    }
+    m.rowStart[coarseCount] = static_cast<uint32_t>(m.column.size());
+    m.blocks.resize(9 * m.column.size());
+    coarse.inverseBlocks.resize(9 * coarseCount);
+    coarse.bStore.resize(3 * coarseCount);
+    coarse.xStore.resize(3 * coarseCount);
+    coarse.t.resize(3 * coarseCount);
+    levels_.push_back(move(coarse));
+    fineMatrix = &levels_.back().matrix;
+    fineRows = coarseRows;
+    fineCount = coarseCount;
+    fineFirst = 0;
+  }
+}
+
+void ClothMultigrid::Galerkin(size_t l, size_t begin, size_t end) {
+  Level &coarse = levels_[l];
+  const Level &fine = levels_[l - 1];
+  BlockSparseMatrix &m = coarse.matrix;
+  for (size_t c = begin; c < end; ++c) {
+    const uint32_t *first = &m.column[0] + m.rowStart[c];
+    const uint32_t *last = &m.column[0] + m.rowStart[c + 1];
+    fill(&m.blocks[9 * m.rowStart[c]], &m.blocks[9 * m.rowStart[c + 1]], 0.0f);
+    for (uint32_t k = fine.rStart[c]; k < fine.rStart[c + 1]; ++k) {
+      const uint32_t i = fine.rColumn[k];
+      const float wi = fine.rWeight[k];
+      for (uint32_t s = fine.a->rowStart[i]; s < fine.a->rowStart[i + 1]; ++s) {
+        const uint32_t j = fine.a->column[s];
+        const float *block = &fine.a->blocks[9 * s];
+        for (uint32_t p = fine.pStart[j]; p < fine.pStart[j + 1]; ++p) {
+          const float w = wi * fine.pWeight[p];
+          float *to = &m.blocks[9 * (lower_bound(first, last, fine.pColumn[p]) - &m.column[0])];
+          for (int e = 0; e < 9; ++e) {
+            to[e] += w * block[e];
+          }
+        }
+      }
+    }
+    InvertBlock(&m.blocks[9 * coarse.diagonal[c]], &coarse.inverseBlocks[9 * c]);
+  }
+}
+
+void ClothMultigrid::Update(const BlockSparseMatrix &a, const float *inverse, JobPool &pool) {
+  if (levels_.empty()) {
+    return;
+  }
+  levels_[0].a = &a;
+  levels_[0].inverse = inverse;
+  // each level is made from the one above, so they go in order
+  for (size_t l = 1; l < levels_.size(); ++l) {
+    levels_[l].a = &levels_[l].matrix;
+    levels_[l].inverse = levels_[l].inverseBlocks.data();
+    pool.ParallelFor(levels_[l].matrix.Rows(), rowGrain, [this, l](size_t begin, size_t end) { Galerkin(l, begin, end); });
+  }
+}
+
+void ClothMultigrid::Smooth(size_t l, int sweeps, bool fromZero, JobPool &pool) {
+  Level &v = levels_[l];
+  const size_t count = v.a->Rows();
+  // x += w D^-1 (b - A x), through the residual so every row sees the others' values from before the sweep
+  auto step = [&v](const float *t, bool add, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const float *d = v.inverse + 9 * i;
+      const float *ti = t + 3 * i;
+      float *xi = v.x + 3 * i;
+      for (int c = 0; c < 3; ++c) {
+        const float dx = jacobiWeight * (d[3 * c] * ti[0] + d[3 * c + 1] * ti[1] + d[3 * c + 2] * ti[2]);
+        xi[c] = add ? xi[c] + dx : dx;
+      }
+    }
+  };
+  for (int sweep = 0; sweep < sweeps; ++sweep) {
+    // from zero the residual is the right hand side
+    if (fromZero && sweep == 0) {
+      pool.ParallelFor(count, rowGrain, [&](size_t begin, size_t end) { step(v.b, false, begin, end); });
+      continue;
+    }
+    float *t = v.t.data();
+    pool.ParallelFor(count, rowGrain, [&](size_t begin, size_t end) {
+      v.a->Multiply(v.x, t, begin, end);
+      for (size_t i = 3 * begin; i < 3 * end; ++i) {
+        t[i] = v.b[i] - t[i];
+      }
+    });
+    pool.ParallelFor(count, rowGrain, [&](size_t begin, size_t end) { step(t, true, begin, end); });
+  }
+}
+
+void ClothMultigrid::Apply(const float *r, float *z, JobPool &pool) {
+  const size_t levels = levels_.size();
+  levels_[0].b = r;
+  levels_[0].x = z;
+  for (size_t l = 1; l < levels; ++l) {
+    levels_[l].b = levels_[l].bStore.data();
+    levels_[l].x = levels_[l].xStore.data();
+  }
+  // down: smooth, then hand the residual to the coarser level
+  for (size_t l = 0; l + 1 < levels; ++l) {
+    Level &fine = levels_[l];
+    Level &coarse = levels_[l + 1];
+    Smooth(l, smoothSweeps, true, pool);
+    float *t = fine.t.data();
+    pool.ParallelFor(fine.a->Rows(), rowGrain, [&](size_t begin, size_t end) {
+      fine.a->Multiply(fine.x, t, begin, end);
+      for (size_t i = 3 * begin; i < 3 * end; ++i) {
+        t[i] = fine.b[i] - t[i];
+      }
+    });
+    float *b = coarse.bStore.data();
+    pool.ParallelFor(coarse.a->Rows(), rowGrain, [&](size_t begin, size_t end) {
+      for (size_t c = begin; c < end; ++c) {
+        float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+        for (uint32_t k = fine.rStart[c]; k < fine.rStart[c + 1]; ++k) {
+          const float *ti = t + 3 * fine.rColumn[k];
+          sx += fine.rWeight[k] * ti[0];
+          sy += fine.rWeight[k] * ti[1];
+          sz += fine.rWeight[k] * ti[2];
+        }
+        b[3 * c] = sx;
+        b[3 * c + 1] = sy;
+        b[3 * c + 2] = sz;
+      }
+    });
+  }
+  Smooth(levels - 1, coarseSweeps, true, pool);
+  // up: add the interpolated coarse correction, then smooth it in
+  for (size_t l = levels - 1; l-- > 0;) {
+    Level &fine = levels_[l];
+    const float *xc = levels_[l + 1].x;
+    pool.ParallelFor(fine.a->Rows(), rowGrain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        for (uint32_t p = fine.pStart[i]; p < fine.pStart[i + 1]; ++p) {
+          const float *xj = xc + 3 * fine.pColumn[p];
+          fine.x[3 * i] += fine.pWeight[p] * xj[0];
+          fine.x[3 * i + 1] += fine.pWeight[p] * xj[1];
+          fine.x[3 * i + 2] += fine.pWeight[p] * xj[2];
+        }
+      }
+    });
+    Smooth(l, smoothSweeps, false, pool);
+  }
+}
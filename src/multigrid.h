@@ -0,0 +1,51 @@
+#pragma once
+#include "blocksparse.h"
+#include "jobs.h"
+#include <cstdint>
+#include <vector>
+
+//Geometric multigrid over the rows x rows cloth grid, used as the preconditioner of the implicit solver.
+//Every level keeps every other row and column of the one above, node x * rows + z; a dropped node is interpolated
+//from its 2 or 4 kept neighbours (prolongation) and gives its residual back to them with the same weights
+//(restriction). The coarse matrices are the fine one seen through those weights (R A P), so nothing about the springs
+//has to be known. Particles outside the grid are carried down unchanged.
+//A V-cycle smooths with damped block Jacobi the same number of times on the way down and up, so it is symmetric and
+//can precondition conjugate gradient. Stiffness waves cross the coarse levels in a few sweeps, so the iterations per
+//tick don't grow with the size of the cloth as they do with Jacobi alone.
+class ClothMultigrid {
+public:
+  ClothMultigrid();
+  //levels below a matrix of the pattern of a, whose rows first to first + rows^2 - 1 are the grid nodes.
+  //A grid too small to coarsen gives no levels.
+  void Build(const BlockSparseMatrix &a, uint32_t first, size_t rows);
+  void Clear();
+  //levels including the fine one, 0 before Build
+  size_t Levels() const { return levels_.size(); }
+  //the coarse matrices for the values of a, inverse holds the inverted diagonal blocks of a
+  void Update(const BlockSparseMatrix &a, const float *inverse, JobPool &pool);
+  //z = one V-cycle on A z = r starting from z = 0, 3 floats per row
+  void Apply(const float *r, float *z, JobPool &pool);
+
+private:
+  struct Level {
+    //matrix and inverted diagonal blocks, the fine level's belong to the caller
+    const BlockSparseMatrix *a;
+    const float *inverse;
+    BlockSparseMatrix matrix;
+    std::vector<float> inverseBlocks;
+    std::vector<uint32_t> diagonal;
+    //right hand side, solution and residual, the fine level's right hand side and solution are the caller's
+    const float *b;
+    float *x;
+    std::vector<float> bStore, xStore, t;
+    //prolongation from the next level, by row of this one, and restriction to it, by row of the next one
+    std::vector<uint32_t> pStart, pColumn, rStart, rColumn;
+    std::vector<float> pWeight, rWeight;
+    Level() : a(nullptr), inverse(nullptr), b(nullptr), x(nullptr) {}
+  };
+
+  void Galerkin(size_t l, size_t begin, size_t end);
+  void Smooth(size_t l, int sweeps, bool fromZero, JobPool &pool);
+
+  std::vector<Level> levels_;
+};
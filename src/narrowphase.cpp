@@ -0,0 +1,204 @@
+#include "narrowphase.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+void SphereSet::Resize(size_t n) {
+  x.resize(n);
+  y.resize(n);
+  z.resize(n);
+  radius.resize(n);
+  body.resize(n);
+}
+
+void ContactBuffer::Reserve(size_t n) {
+  if (n <= bodyA.size()) {
+    return;
+  }
+  // at least double, so a slowly growing contact count doesn't resize every tick
+  n = max(n, bodyA.size() * 2);
+  bodyA.resize(n);
+  bodyB.resize(n);
+  nx.resize(n);
+  ny.resize(n);
+  nz.resize(n);
+  depth.resize(n);
+}
+
+void ContactBuffer::CopyTo(ContactBuffer &out, size_t at) const {
+  copy(bodyA.begin(), bodyA.begin() + count, out.bodyA.begin() + at);
+  copy(bodyB.begin(), bodyB.begin() + count, out.bodyB.begin() + at);
+  copy(nx.begin(), nx.begin() + count, out.nx.begin() + at);
+  copy(ny.begin(), ny.begin() + count, out.ny.begin() + at);
+  copy(nz.begin(), nz.begin() + count, out.nz.begin() + at);
+  copy(depth.begin(), depth.begin() + count, out.depth.begin() + at);
+}
+
+void CollideSpheresPlane(const SphereSet &spheres, const glm::vec3 &point, const glm::vec3 &normal, ContactBuffer &out) {
+  CollideSpheresPlane(spheres, point, normal, 0, spheres.Size(), out);
+}
+
+void CollideSpheresPlane(const SphereSet &spheres, const glm::vec3 &point, const glm::vec3 &normal, size_t begin,
+                         size_t end, ContactBuffer &out) {
+  // every sphere could be touching the plane
+  out.Reserve(out.count + (end - begin));
+  size_t i = begin;
+#ifdef PHYS_X86
+  const __m128 px = _mm_set1_ps(point.x);
+  const __m128 py = _mm_set1_ps(point.y);
+  const __m128 pz = _mm_set1_ps(point.z);
+  const __m128 nx = _mm_set1_ps(normal.x);
+  const __m128 ny = _mm_set1_ps(normal.y);
+  const __m128 nz = _mm_set1_ps(normal.z);
+  for (; i + 4 <= end; i += 4) {
+    const __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&spheres.x[i]), px), nx),
+                                              _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&spheres.y[i]), py), ny)),
+                                   _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&spheres.z[i]), pz), nz));
+    const __m128 r = _mm_loadu_ps(&spheres.radius[i]);
+    const int hits = _mm_movemask_ps(_mm_cmple_ps(dist, r));
+    // most blocks are clear of the plane
+    if (!hits) {
+      continue;
+    }
+    float depth[4];
+    _mm_storeu_ps(depth, _mm_sub_ps(r, dist));
+    for (int lane = 0; lane < 4; ++lane) {
+      if (hits & (1 << lane)) {
+        out.Add(spheres.body[i + lane], BODY_STATIC, normal.x, normal.y, normal.z, depth[lane]);
+      }
+    }
+  }
+#endif
+  for (; i < end; ++i) {
+    float depth;
+    if (SpherePlaneContact(spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i], point, normal, depth)) {
+      out.Add(spheres.body[i], BODY_STATIC, normal.x, normal.y, normal.z, depth);
+    }
+  }
+}
+
+//contact of one pair, the normal points from the second sphere to the first
+static inline void addPairContact(const SphereSet &s, const SpherePair &p, ContactBuffer &out) {
+  glm::vec3 n;
+  float depth;
+  if (SpherePairContact(glm::vec3(s.x[p.a], s.y[p.a], s.z[p.a]), s.radius[p.a], glm::vec3(s.x[p.b], s.y[p.b], s.z[p.b]),
+                        s.radius[p.b], n, depth)) {
+    out.Add(s.body[p.a], s.body[p.b], n.x, n.y, n.z, depth);
+  }
+}
+
+void CollideSpherePairs(const SphereSet &spheres, const SpherePair *pairs, size_t count, ContactBuffer &out) {
+  out.Reserve(out.count + count);
+  size_t i = 0;
+#ifdef PHYS_X86
+  // the pairs are scattered, so gather 4 at a time and only take the square root of the hits
+  for (; i + 4 <= count; i += 4) {
+    const SpherePair *p = pairs + i;
+    const __m128 dx = _mm_sub_ps(_mm_setr_ps(spheres.x[p[0].b], spheres.x[p[1].b], spheres.x[p[2].b], spheres.x[p[3].b]),
+                                 _mm_setr_ps(spheres.x[p[0].a], spheres.x[p[1].a], spheres.x[p[2].a], spheres.x[p[3].a]));
+    const __m128 dy = _mm_sub_ps(_mm_setr_ps(spheres.y[p[0].b], spheres.y[p[1].b], spheres.y[p[2].b], spheres.y[p[3].b]),
+                                 _mm_setr_ps(spheres.y[p[0].a], spheres.y[p[1].a], spheres.y[p[2].a], spheres.y[p[3].a]));
+    const __m128 dz = _mm_sub_ps(_mm_setr_ps(spheres.z[p[0].b], spheres.z[p[1].b], spheres.z[p[2].b], spheres.z[p[3].b]),
+                                 _mm_setr_ps(spheres.z[p[0].a], spheres.z[p[1].a], spheres.z[p[2].a], spheres.z[p[3].a]));
+    const __m128 sum = _mm_add_ps(
+        _mm_setr_ps(spheres.radius[p[0].a], spheres.radius[p[1].a], spheres.radius[p[2].a], spheres.radius[p[3].a]),
+        _mm_setr_ps(spheres.radius[p[0].b], spheres.radius[p[1].b], spheres.radius[p[2].b], spheres.radius[p[3].b]));
+    const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    const int hits = _mm_movemask_ps(_mm_cmplt_ps(d2, _mm_mul_ps(sum, sum)));
+    for (int lane = 0; lane < 4; ++lane) {
+      if (hits & (1 << lane)) {
+        addPairContact(spheres, p[lane], out);
+      }
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    addPairContact(spheres, pairs[i], out);
+  }
+}
+
+void ResolveContacts(const ContactBuffer &contacts, ParticleStore &ps) {
+  //Coefficient of return has been removed since cloth particles don't have to bounce
+  for (size_t c = 0; c < contacts.count; ++c) {
+    const glm::vec3 n(contacts.nx[c], contacts.ny[c], contacts.nz[c]);
+    const float depth = contacts.depth[c];
+    // the first body takes half the depth, the second one a tenth of that
+    if (contacts.bodyA[c] >= 0) {
+      const size_t i = static_cast<size_t>(contacts.bodyA[c]);
+      ps.SetPosition(i, ps.Position(i) + n * (depth * 0.5f));
+      ps.SetPrevPosition(i, ps.Position(i));
+    }
+    if (contacts.bodyB[c] >= 0) {
+      const size_t i = static_cast<size_t>(contacts.bodyB[c]);
+      ps.SetPosition(i, ps.Position(i) - n * (depth * 0.05f));
+      ps.SetPrevPosition(i, ps.Position(i));
+    }
+  }
+}
+
+//contacts of each particle, contact c is entry 2c for its first body and 2c + 1 for its second
+static vector<uint32_t> contactStart;
+static vector<uint32_t> contactEntries;
+//particles per job when resolving contacts
+static const size_t resolveGrain = 1024;
+
+void ResolveContactsParallel(const ContactBuffer &contacts, ParticleStore &ps, JobPool &pool) {
+  const size_t count = ps.Size();
+  if (pool.Size() == 1) {
+    ResolveContacts(contacts, ps);
+    return;
+  }
+  // room for every contact the buffer holds, so the first tick past the grain or a tick with more contacts than the
+  // last doesn't allocate mid run
+  contactStart.reserve(count + 1);
+  contactEntries.reserve(2 * contacts.bodyA.size());
+  if (contacts.count <= resolveGrain) {
+    ResolveContacts(contacts, ps);
+    return;
+  }
+  // counting sort of the contact ends by particle, stable so each particle keeps the buffer order
+  contactStart.assign(count + 1, 0);
+  for (size_t c = 0; c < contacts.count; ++c) {
+    if (contacts.bodyA[c] >= 0) {
+      ++contactStart[contacts.bodyA[c] + 1];
+    }
+    if (contacts.bodyB[c] >= 0) {
+      ++contactStart[contacts.bodyB[c] + 1];
+    }
+  }
+  for (size_t i = 0; i < count; ++i) {
+    contactStart[i + 1] += contactStart[i];
+  }
+  contactEntries.resize(contactStart[count]);
+  for (size_t c = 0; c < contacts.count; ++c) {
+    if (contacts.bodyA[c] >= 0) {
+      contactEntries[contactStart[contacts.bodyA[c]]++] = static_cast<uint32_t>(2 * c);
+    }
+    if (contacts.bodyB[c] >= 0) {
+      contactEntries[contactStart[contacts.bodyB[c]]++] = static_cast<uint32_t>(2 * c + 1);
+    }
+  }
+  // the fill moved every start to the next particle, shift them back
+  for (size_t i = count; i > 0; --i) {
+    contactStart[i] = contactStart[i - 1];
+  }
+  contactStart[0] = 0;
+
+  pool.ParallelFor(count, resolveGrain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      for (uint32_t k = contactStart[i]; k < contactStart[i + 1]; ++k) {
+        const size_t c = contactEntries[k] >> 1;
+        const glm::vec3 n(contacts.nx[c], contacts.ny[c], contacts.nz[c]);
+        // same arithmetic as ResolveContacts, in the same order
+        if (contactEntries[k] & 1) {
+          ps.SetPosition(i, ps.Position(i) - n * (contacts.depth[c] * 0.05f));
+        } else {
+          ps.SetPosition(i, ps.Position(i) + n * (contacts.depth[c] * 0.5f));
+        }
+        ps.SetPrevPosition(i, ps.Position(i));
+      }
+    }
+  });
+}
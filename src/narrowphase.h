@@ -0,0 +1,85 @@
+#pragma once
+#include "broadphase.h"
+#include "jobs.h"
+#include "particles.h"
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+//contact sides that aren't particle store slots: static geometry, and spheres moved by their entity instead of the
+//store. Contacts push neither, but a kinematic sphere moves on its own and can disturb a particle at rest.
+enum ContactBody { BODY_STATIC = -1, BODY_KINEMATIC = -2 };
+
+//Spheres to test this tick, as structure of arrays so a block of centres can be tested at once
+struct SphereSet {
+  std::vector<float> x, y, z, radius;
+  //particle store slot the sphere moves with, BODY_KINEMATIC if it isn't attached to a particle
+  std::vector<int32_t> body;
+
+  size_t Size() const { return x.size(); }
+  void Resize(size_t n);
+};
+
+//Contacts found this tick. Arrays only grow, so once warmed up filling the buffer never allocates.
+struct ContactBuffer {
+  //particle store slots of the two sides, or a ContactBody for the ones that aren't particles
+  std::vector<int32_t> bodyA, bodyB;
+  //normal pointing from b to a, and penetration depth
+  std::vector<float> nx, ny, nz, depth;
+  size_t count;
+
+  ContactBuffer() : count(0) {}
+  void Clear() { count = 0; }
+  //makes room for at least n contacts
+  void Reserve(size_t n);
+  //copies the contacts into out starting at contact at, out must have room for them
+  void CopyTo(ContactBuffer &out, size_t at) const;
+  void Add(int32_t a, int32_t b, float x, float y, float z, float d) {
+    bodyA[count] = a;
+    bodyB[count] = b;
+    nx[count] = x;
+    ny[count] = y;
+    nz[count] = z;
+    depth[count] = d;
+    ++count;
+  }
+};
+
+//one sphere against the plane through point with the given (unit) normal: whether it touches, and how deep
+inline bool SpherePlaneContact(float x, float y, float z, float radius, const glm::vec3 &point, const glm::vec3 &normal,
+                               float &depth) {
+  const float dist = (x - point.x) * normal.x + (y - point.y) * normal.y + (z - point.z) * normal.z;
+  depth = radius - dist;
+  return dist <= radius;
+}
+
+//sphere a against sphere b: whether they overlap, the normal pointing from b to a and the depth.
+//Coincident centres have no direction to push apart in, so they don't count.
+inline bool SpherePairContact(const glm::vec3 &a, float ra, const glm::vec3 &b, float rb, glm::vec3 &normal,
+                              float &depth) {
+  const float dx = b.x - a.x;
+  const float dy = b.y - a.y;
+  const float dz = b.z - a.z;
+  const float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+  const float sumRadius = ra + rb;
+  if (distance < sumRadius && distance > 0.0f) {
+    const float inv = 1.0f / distance;
+    normal = glm::vec3(-dx * inv, -dy * inv, -dz * inv);
+    depth = sumRadius - distance;
+    return true;
+  }
+  return false;
+}
+
+//tests every sphere against the plane through point with the given (unit) normal, 4 spheres at a time
+void CollideSpheresPlane(const SphereSet &spheres, const glm::vec3 &point, const glm::vec3 &normal, ContactBuffer &out);
+//same, for spheres [begin, end) only
+void CollideSpheresPlane(const SphereSet &spheres, const glm::vec3 &point, const glm::vec3 &normal, size_t begin,
+                         size_t end, ContactBuffer &out);
+//tests the candidate pairs found by the broadphase, 4 pairs at a time
+void CollideSpherePairs(const SphereSet &spheres, const SpherePair *pairs, size_t count, ContactBuffer &out);
+//pushes the particles out of contact, a moves most of the way and b a little, and stops them
+void ResolveContacts(const ContactBuffer &contacts, ParticleStore &ps);
+//same result bit for bit, spread over the pool by particle: every particle applies its own contacts in buffer order
+void ResolveContactsParallel(const ContactBuffer &contacts, ParticleStore &ps, JobPool &pool);
@@ -0,0 +1,66 @@
+#include "particlepool.h"
+#include <new>
+
+using namespace std;
+
+//offset rounded up to the alignment of T
+template <typename T> static size_t alignFor(size_t offset) {
+  const size_t a = alignof(T);
+  return (offset + a - 1) / a * a;
+}
+
+ParticlePool::ParticlePool()
+    : block_(nullptr), entities_(nullptr), physics_(nullptr), colliders_(nullptr), size_(0), capacity_(0),
+      components_(2) {}
+
+ParticlePool::~ParticlePool() { Release(); }
+
+void ParticlePool::Reserve(size_t count, size_t extraComponents) {
+  Release();
+  components_ = 2 + extraComponents;
+  // the three arrays one after the other in one allocation
+  const size_t physicsAt = alignFor<cPhysics>(count * sizeof(Entity));
+  const size_t collidersAt = alignFor<cSphereCollider>(physicsAt + count * sizeof(cPhysics));
+  const size_t bytes = collidersAt + count * sizeof(cSphereCollider);
+  block_ = ::operator new(bytes);
+  unsigned char *base = static_cast<unsigned char *>(block_);
+  entities_ = reinterpret_cast<Entity *>(base);
+  physics_ = reinterpret_cast<cPhysics *>(base + physicsAt);
+  colliders_ = reinterpret_cast<cSphereCollider *>(base + collidersAt);
+  capacity_ = count;
+  // the particle store grows once too
+  GetParticles().Reserve(GetParticles().Size() + count);
+}
+
+ParticlePool::Handle ParticlePool::Add(const glm::vec3 &pos, double mass, float radius) {
+  // nothing can move once added, so a full pool can't grow
+  if (size_ >= capacity_) {
+    return invalidHandle;
+  }
+  const Handle h = static_cast<Handle>(size_);
+  Entity *e = new (entities_ + h) Entity();
+  e->SetPosition(pos);
+  e->ReserveComponents(components_);
+  // same components, in the same order, as CreateParticle
+  cPhysics *phys = new (physics_ + h) cPhysics();
+  phys->SetMass(mass);
+  e->AttachComponent(phys);
+  cSphereCollider *coll = new (colliders_ + h) cSphereCollider();
+  coll->radius = radius;
+  e->AttachComponent(coll);
+  ++size_;
+  return h;
+}
+
+void ParticlePool::Release() {
+  // the entities destroy their pooled components in place, the memory goes back in one go
+  while (size_) {
+    entities_[--size_].~Entity();
+  }
+  ::operator delete(block_);
+  block_ = nullptr;
+  entities_ = nullptr;
+  physics_ = nullptr;
+  colliders_ = nullptr;
+  capacity_ = 0;
+}
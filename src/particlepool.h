@@ -0,0 +1,45 @@
+#pragma once
+#include "game.h"
+#include "physics.h"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+//Storage for a whole scene's worth of particle entities: the entities, their physics and their sphere colliders
+//are constructed in place in a single block reserved up front, and destroyed and freed together by Release.
+//Nothing moves once added, so handles (and the pointers they give) stay valid until Release.
+class ParticlePool {
+public:
+  typedef uint32_t Handle;
+  //what Add returns when the pool is full
+  static const Handle invalidHandle = ~Handle(0);
+
+  ParticlePool();
+  ~ParticlePool();
+  //reserves the block for count particles, releasing whatever the pool held before. Every entity gets room for its
+  //physics and collider plus extraComponents more that the caller attaches later.
+  void Reserve(size_t count, size_t extraComponents = 0);
+  //builds a particle entity at pos with the given mass and collider radius, invalidHandle if the pool is full
+  Handle Add(const glm::vec3 &pos, double mass, float radius);
+  //destroys every particle, last added first, and frees the block
+  void Release();
+
+  size_t Size() const { return size_; }
+  size_t Capacity() const { return capacity_; }
+  Entity *GetEntity(Handle h) const { return entities_ + h; }
+  cPhysics *GetPhysics(Handle h) const { return physics_ + h; }
+  cSphereCollider *GetCollider(Handle h) const { return colliders_ + h; }
+
+private:
+  ParticlePool(const ParticlePool &);
+  ParticlePool &operator=(const ParticlePool &);
+
+  void *block_;
+  Entity *entities_;
+  cPhysics *physics_;
+  cSphereCollider *colliders_;
+  size_t size_;
+  size_t capacity_;
+  //components reserved on every entity
+  size_t components_;
+};
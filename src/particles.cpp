@@ -0,0 +1,75 @@
+#include "particles.h"
+#include "physics.h"
+
+using namespace std;
+using namespace glm;
+
+ParticleStore::ParticleStore() : gravity(vec3(0, -10.0f, 0)) {}
+
+void ParticleStore::Reserve(size_t n) {
+  px.reserve(n);
+  py.reserve(n);
+  pz.reserve(n);
+  ox.reserve(n);
+  oy.reserve(n);
+  oz.reserve(n);
+  fx.reserve(n);
+  fy.reserve(n);
+  fz.reserve(n);
+  invMass.reserve(n);
+  pinned.reserve(n);
+  owner.reserve(n);
+}
+
+size_t ParticleStore::Add(cPhysics *p, const vec3 &pos, double mass) {
+  px.push_back(pos.x);
+  py.push_back(pos.y);
+  pz.push_back(pos.z);
+  ox.push_back(pos.x);
+  oy.push_back(pos.y);
+  oz.push_back(pos.z);
+  fx.push_back(0.0f);
+  fy.push_back(0.0f);
+  fz.push_back(0.0f);
+  invMass.push_back(static_cast<float>(1.0 / mass));
+  pinned.push_back(0);
+  owner.push_back(p);
+  return px.size() - 1;
+}
+
+void ParticleStore::Remove(size_t i) {
+  const size_t last = Size() - 1;
+  if (i != last) {
+    px[i] = px[last];
+    py[i] = py[last];
+    pz[i] = pz[last];
+    ox[i] = ox[last];
+    oy[i] = oy[last];
+    oz[i] = oz[last];
+    fx[i] = fx[last];
+    fy[i] = fy[last];
+    fz[i] = fz[last];
+    invMass[i] = invMass[last];
+    pinned[i] = pinned[last];
+    owner[i] = owner[last];
+    owner[i]->index = i;
+  }
+  px.pop_back();
+  py.pop_back();
+  pz.pop_back();
+  ox.pop_back();
+  oy.pop_back();
+  oz.pop_back();
+  fx.pop_back();
+  fy.pop_back();
+  fz.pop_back();
+  invMass.pop_back();
+  pinned.pop_back();
+  owner.pop_back();
+}
+
+ParticleStore &GetParticles() {
+  //never destroyed, particles owned by other globals can outlive main
+  static ParticleStore *store = new ParticleStore();
+  return *store;
+}
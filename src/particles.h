@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+class cPhysics;
+
+//why a particle is pinned, any bit set keeps it from moving
+enum ParticleFlags { PARTICLE_FIXED = 1, PARTICLE_ASLEEP = 2 };
+
+//Structure of arrays holding every simulated particle, so the integrator can walk it linearly.
+//cPhysics components are thin handles into it, through their slot index.
+struct ParticleStore {
+  //current position
+  std::vector<float> px, py, pz;
+  //position at the previous tick, velocity is implicit (position - previous position)
+  std::vector<float> ox, oy, oz;
+  //forces accumulated since the last tick
+  std::vector<float> fx, fy, fz;
+  //1 / mass
+  std::vector<float> invMass;
+  //pinned particles are not integrated, ParticleFlags bits
+  std::vector<uint8_t> pinned;
+  //handle owning every slot, patched when a removal moves the last particle into the hole
+  std::vector<cPhysics *> owner;
+  //gravity is shared by all the particles
+  glm::vec3 gravity;
+
+  ParticleStore();
+  size_t Size() const { return px.size(); }
+  void Reserve(size_t n);
+  //adds a particle and returns its slot
+  size_t Add(cPhysics *p, const glm::vec3 &pos, double mass);
+  //removes the particle in slot i in O(1), the last particle takes its slot
+  void Remove(size_t i);
+
+  glm::vec3 Position(size_t i) const { return glm::vec3(px[i], py[i], pz[i]); }
+  glm::vec3 PrevPosition(size_t i) const { return glm::vec3(ox[i], oy[i], oz[i]); }
+  glm::vec3 Velocity(size_t i) const { return glm::vec3(px[i] - ox[i], py[i] - oy[i], pz[i] - oz[i]); }
+  void SetPosition(size_t i, const glm::vec3 &p) {
+    px[i] = p.x;
+    py[i] = p.y;
+    pz[i] = p.z;
+  }
+  void SetPrevPosition(size_t i, const glm::vec3 &p) {
+    ox[i] = p.x;
+    oy[i] = p.y;
+    oz[i] = p.z;
+  }
+  void AddForce(size_t i, const glm::vec3 &f) {
+    fx[i] += f.x;
+    fy[i] += f.y;
+    fz[i] += f.z;
+  }
+};
+
+//the particle store used by every cPhysics
+ParticleStore &GetParticles();
@@ -1,123 +1,390 @@
 #include "physics.h"
+#include "broadphase.h"
 #include "collision.h"
+#include "implicit.h"
+#include "integrate.h"
+#include "narrowphase.h"
+#include "selfcollision.h"
+#include "sleep.h"
+#include "xpbd.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <glm/glm.hpp>
 using namespace std;
 using namespace glm;
-static vector<cPhysics *> physicsScene;
-static vector<cCollider *> colliders;
-
-static dvec3 initialV = dvec3(0.0, 0.0, 0.0);
-//flag to determine if a particle has to be rendered and updated
-bool flag = false;
-
-void Resolve(const collisionInfo &ci) {
+//finite colliders go through the broadphase, infinite ones are tested against every sphere.
+//Both lists are gathered from the world every tick, so colliders don't register themselves.
+static vector<cSphereCollider *> sphereColliders;
+static vector<cPlaneCollider *> planeColliders;
+static UniformGrid broadphase;
+static const SpringTopology *springs = nullptr;
+static const SpringParams *springParams = nullptr;
+static SelfCollision *selfCollision = nullptr;
+static SleepTiles *sleepTiles = nullptr;
+//what the sleeping particles last rested under, they wake when it changes
+static vec3 sleepGravity;
+static SpringParams sleepParams;
+static bool sleepDeferred = false;
+static SolverKind solver = SOLVER_SPRINGS;
+static XpbdSolver xpbd;
+static ImplicitSolver implicit;
+//particles per job when copying positions to the entities
+static const size_t syncGrain = 4096;
+//work per job of the collision stages: spheres searched by the broadphase, pairs or spheres tested by the
+//narrowphase (a multiple of 4, the SIMD width), and particles integrated
+static const size_t findGrain = 1024;
+static const size_t collideGrain = 4096;
+static const size_t integrateGrain = 8192;
+//results of each job, gathered in job order so they don't depend on which thread ran what
+static vector<vector<SpherePair>> chunkPairs;
+static vector<ContactBuffer> chunkContacts;
+static vector<size_t> chunkOffsets;
+//largest value of each job of the tick measures
+static vector<float> chunkMax;
+//springs or particles per job when measuring the tick
+static const size_t measureGrain = 8192;
+
+//candidate pairs of the grid, the spheres split in ranges searched in parallel
+static void findPairs(const UniformGrid &grid, vector<SpherePair> &pairs, JobPool &pool) {
+  const size_t chunks = JobPool::Chunks(grid.Size(), findGrain);
+  if (chunkPairs.size() < chunks) {
+    chunkPairs.resize(chunks);
+  }
+  pool.ParallelFor(chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      chunkPairs[k].clear();
+      grid.FindPairs(chunkPairs[k], k * findGrain, std::min((k + 1) * findGrain, grid.Size()));
+    }
+  });
+  // the pair order is the serial order whatever the threads did
+  for (size_t k = 0; k < chunks; ++k) {
+    pairs.insert(pairs.end(), chunkPairs[k].begin(), chunkPairs[k].end());
+  }
+}
 
-	//Coefficient of return has been removed since cloth particles don't have to bounce
-  auto a = ci.c1->GetParent()->GetComponents("Physics");
-  if (a.size() == 1) {
-    const auto p = static_cast<cPhysics *>(a[0]);
-    p->position += ci.normal * (ci.depth * 0.5);
-    const double currentSpeed = glm::length(p->position - p->prev_position);
-    p->prev_position = p->position;
+//every narrowphase test of the tick, as jobs of each shape combination the shape table batches, one after the
+//other: sphere pairs first, then spheres against each plane.
+//In deterministic mode the contacts are put together in job order once all the jobs are done, otherwise each job
+//copies its contacts out as soon as it is done, in whatever order the jobs finish.
+static void collide(const SphereSet &spheres, const vector<SpherePair> &pairs, ContactBuffer &contacts, JobPool &pool) {
+  const collision::ShapeBatch batch = {&spheres, pairs.data(), pairs.size(), planeColliders.data(),
+                                       planeColliders.size()};
+  // the first job of each combination that has any
+  struct Combination {
+    ColliderShape a, b;
+    size_t first;
+  };
+  Combination combinations[SHAPE_COUNT * SHAPE_COUNT];
+  size_t combinationCount = 0;
+  size_t chunks = 0;
+  for (int a = 0; a < SHAPE_COUNT; ++a) {
+    for (int b = a; b < SHAPE_COUNT; ++b) {
+      const size_t jobs = collision::BatchJobs(ColliderShape(a), ColliderShape(b), batch, collideGrain);
+      if (jobs) {
+        combinations[combinationCount++] = {ColliderShape(a), ColliderShape(b), chunks};
+        chunks += jobs;
+      }
+    }
+  }
+  if (chunkContacts.size() < chunks) {
+    chunkContacts.resize(chunks);
   }
-  auto b = ci.c2->GetParent()->GetComponents("Physics");
-  if (b.size() == 1) {
-    const auto p = static_cast<cPhysics *>(b[0]);
-    p->position += -ci.normal * (ci.depth * 0.5 * 0.1);
-    const double currentSpeed = glm::length(p->position - p->prev_position);
-    p->prev_position = p->position;
+  const bool ordered = pool.Deterministic();
+  // no more contacts than tests
+  contacts.Reserve(pairs.size() + spheres.Size() * planeColliders.size());
+  atomic<size_t> cursor(0);
+  pool.ParallelFor(chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      ContactBuffer &out = chunkContacts[k];
+      out.Clear();
+      size_t c = combinationCount - 1;
+      while (combinations[c].first > k) {
+        --c;
+      }
+      const Combination &combination = combinations[c];
+      collision::CollideBatch(combination.a, combination.b, batch, k - combination.first, collideGrain, out);
+      if (!ordered) {
+        out.CopyTo(contacts, cursor.fetch_add(out.count));
+      }
+    }
+  });
+  if (!ordered) {
+    contacts.count = cursor;
+    return;
   }
+  chunkOffsets.resize(chunks + 1);
+  chunkOffsets[0] = 0;
+  for (size_t k = 0; k < chunks; ++k) {
+    chunkOffsets[k + 1] = chunkOffsets[k] + chunkContacts[k].count;
+  }
+  pool.ParallelFor(chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      chunkContacts[k].CopyTo(contacts, chunkOffsets[k]);
+    }
+  });
+  contacts.count = chunkOffsets[chunks];
 }
 
 //Default mass is 1.0
-cPhysics::cPhysics() : forces(dvec3(0)), mass(1.0), Component("Physics") { physicsScene.push_back(this); }
+cPhysics::cPhysics() : Component("Physics") { index = GetParticles().Add(this, vec3(0), 1.0); }
 
-cPhysics::~cPhysics() {
-  auto position = std::find(physicsScene.begin(), physicsScene.end(), this);
-  if (position != physicsScene.end()) {
-    physicsScene.erase(position);
-  }
+cPhysics::~cPhysics() { GetParticles().Remove(index); }
+
+//positions reach the entities through SyncTransforms, once per frame for all the particles
+void cPhysics::Update(double delta) {}
+
+void cPhysics::SetParent(Entity *p) {
+  Component::SetParent(p);
+  SetPosition(Ent_->GetPosition());
+  SetPrevPosition(Ent_->GetPosition());
 }
 
-void cPhysics::Update(double delta) {
-  for (auto &e : physicsScene) {
-    e->GetParent()->SetPosition(e->position);
+vec3 cPhysics::GetPosition() const { return GetParticles().Position(index); }
+
+void cPhysics::SetPosition(const vec3 &p) { GetParticles().SetPosition(index, p); }
+
+vec3 cPhysics::GetPrevPosition() const { return GetParticles().PrevPosition(index); }
+
+void cPhysics::SetPrevPosition(const vec3 &p) { GetParticles().SetPrevPosition(index, p); }
+
+vec3 cPhysics::GetVelocity() const { return GetParticles().Velocity(index); }
+
+double cPhysics::GetMass() const { return 1.0 / GetParticles().invMass[index]; }
+
+void cPhysics::SetMass(double m) {
+  ParticleStore &ps = GetParticles();
+  if (sleepTiles) {
+    sleepTiles->Wake(ps, index);
   }
+  ps.invMass[index] = static_cast<float>(1.0 / m);
 }
 
-void cPhysics::SetParent(Entity *p) {
-  Component::SetParent(p);
-  position = Ent_->GetPosition();
-  prev_position = position;
+bool cPhysics::IsFixed() const { return (GetParticles().pinned[index] & PARTICLE_FIXED) != 0; }
+
+// a sleeping particle stays asleep, whether or not it is fixed
+void cPhysics::SetFixed(bool b) {
+  uint8_t &pinned = GetParticles().pinned[index];
+  pinned = static_cast<uint8_t>((pinned & ~PARTICLE_FIXED) | (b ? PARTICLE_FIXED : 0));
 }
 
-void cPhysics::AddImpulse(const glm::vec3 &i) { forces += i; }
+void cPhysics::AddImpulse(const glm::vec3 &i) {
+  ParticleStore &ps = GetParticles();
+  if (sleepTiles && i != vec3(0.0f)) {
+    sleepTiles->Wake(ps, index);
+  }
+  ps.AddForce(index, i);
+}
 
 float cPhysics::getX()
 {
-	return this->position.x;
+	return GetParticles().px[index];
 }
 
 float cPhysics::getY()
 {
-	return this->position.y;
+	return GetParticles().py[index];
 }
 
 float cPhysics::getZ()
 {
-	return this->position.z;
+	return GetParticles().pz[index];
+}
+
+
+void SetSprings(const SpringTopology *t, const SpringParams *params) {
+  springs = t;
+  springParams = params;
+  implicit.Invalidate();
+}
+
+void SetSolverGrid(uint32_t first, size_t rows) { implicit.SetGrid(first, rows); }
+
+void SetSelfCollision(SelfCollision *s) { selfCollision = s; }
+
+void SetSleep(SleepTiles *s) {
+  sleepTiles = s;
+  sleepGravity = GetParticles().gravity;
+  if (springParams) {
+    sleepParams = *springParams;
+  }
+}
+
+void DeferSleep(bool defer) { sleepDeferred = defer; }
+
+void UpdateSleep(const double dt) {
+  if (sleepTiles) {
+    sleepTiles->Update(GetParticles(), static_cast<float>(dt), GetJobPool());
+  }
+}
+
+void SetSolver(SolverKind kind) { solver = kind; }
+
+SolverKind GetSolver() { return solver; }
+
+const char *SolverName(SolverKind kind) {
+  static const char *names[] = {"springs", "xpbd", "implicit", "multigrid"};
+  return kind < SOLVER_KINDS ? names[kind] : "unknown";
 }
 
+void SetSolverIterations(int iterations) { xpbd.SetIterations(iterations); }
+
+int GetSolverIterations() { return xpbd.Iterations(); }
+
+void SetImplicitLimits(int maxIterations, float tolerance) { implicit.SetLimits(maxIterations, tolerance); }
+
+const ImplicitStats &GetImplicitStats() { return implicit.Stats(); }
 
 void UpdatePhysics(const double t, const double dt) {
-  std::vector<collisionInfo> collisions;
-  // check for collisions
-  {
-    dvec3 pos;
-    dvec3 norm;
-    double depth;
-    for (size_t i = 0; i < colliders.size(); ++i) {
-      for (size_t j = i + 1; j < colliders.size(); ++j) {
-        if (collision::IsColliding(*colliders[i], *colliders[j], pos, norm, depth)) {
-          collisions.push_back({colliders[i], colliders[j], pos, norm, depth});
-        }
+  JobPool &pool = GetJobPool();
+  sphereColliders.clear();
+  planeColliders.clear();
+  EachComponent<cSphereCollider>([](cSphereCollider *c) { sphereColliders.push_back(c); });
+  EachComponent<cPlaneCollider>([](cPlaneCollider *c) { planeColliders.push_back(c); });
+  // sphere colliders not on a particle, moved by their entity: while there are any the tick can't be skipped
+  size_t kinematicSpheres = 0;
+  for (cSphereCollider *c : sphereColliders) {
+    kinematicSpheres += !c->GetBody();
+  }
+  if (sleepTiles) {
+    ParticleStore &ps = GetParticles();
+    // nothing asleep stays put once the forces it came to rest under change
+    if (ps.gravity != sleepGravity || (springParams && memcmp(springParams, &sleepParams, sizeof(SpringParams)))) {
+      sleepTiles->WakeAll(ps);
+      sleepGravity = ps.gravity;
+      if (springParams) {
+        sleepParams = *springParams;
       }
     }
+    // a scene at rest stays at rest until something wakes it
+    if (sleepTiles->AllAsleep() && sleepTiles->Particles() == ps.Size() && !kinematicSpheres) {
+      sleepTiles->Skip();
+      return;
+    }
+  }
+  // spring and damper forces, once per tick
+  if (springs && springParams && solver == SOLVER_SPRINGS) {
+    EvaluateSpringsParallel(*springs, *springParams, GetParticles(), pool);
   }
-  // handle collisions
+  // check for collisions
   {
-    for (auto &c : collisions) {
-      Resolve(c);
+    // sphere bounds and contacts, kept between ticks so they only allocate when the scene grows
+    static SphereSet spheres;
+    static vector<SpherePair> pairs;
+    static ContactBuffer contacts;
+    ParticleStore &ps = GetParticles();
+    const size_t count = sphereColliders.size();
+    spheres.Resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      // spheres on a particle move with the store, others with their entity
+      const cPhysics *body = sphereColliders[i]->GetBody();
+      const vec3 p = body ? ps.Position(body->index) : sphereColliders[i]->GetParent()->GetPosition();
+      spheres.x[i] = p.x;
+      spheres.y[i] = p.y;
+      spheres.z[i] = p.z;
+      spheres.radius[i] = static_cast<float>(sphereColliders[i]->radius);
+      spheres.body[i] = body ? static_cast<int32_t>(body->index) : BODY_KINEMATIC;
     }
+    pairs.clear();
+    broadphase.Build(spheres.x.data(), spheres.y.data(), spheres.z.data(), spheres.radius.data(), count);
+    findPairs(broadphase, pairs, pool);
+
+    // one batched test per shape combination, all into the same contact buffer
+    contacts.Clear();
+    collide(spheres, pairs, contacts, pool);
+    if (sleepTiles) {
+      sleepTiles->FilterContacts(contacts, ps);
+    }
+    // handle collisions
+    ResolveContactsParallel(contacts, ps, pool);
+  }
+  // Integrating using Verlet method, with the selected (scalar or SIMD) kernel, every particle on its own,
+  // or all of them together through the springs with backward Euler
+  if (springs && springParams && (solver == SOLVER_IMPLICIT || solver == SOLVER_MULTIGRID)) {
+    implicit.SetMultigrid(solver == SOLVER_MULTIGRID);
+    implicit.Step(*springs, *springParams, GetParticles(), static_cast<float>(dt), pool);
+  } else {
+    ParticleStore &ps = GetParticles();
+    const float dt2 = static_cast<float>(dt * dt);
+    // the kernel is picked here, once, so the jobs never touch the selection
+    const IntegratorKind kernel = GetIntegrator();
+    pool.ParallelFor(ps.Size(), integrateGrain,
+                     [&ps, dt2, kernel](size_t begin, size_t end) { Integrate(ps, dt2, begin, end, kernel); });
+  }
+  // the constraints pull the predicted positions back together
+  if (springs && springParams && solver == SOLVER_XPBD) {
+    xpbd.Solve(*springs, *springParams, GetParticles(), static_cast<float>(dt), pool);
   }
-  // Integrating using Verlet method
-  for (auto &e : physicsScene) {
-	  if (e->fixed == false)
-	  {
-		  e->Render();
-	  }
-	  else
-	  {
-		  continue;
-	  }
-    
-	
-    // calcualte velocity from current and previous position
-    e->velocity = e->position - e->prev_position;
-	if (flag)
-	{
-		e->velocity += initialV;
-		flag = false;
-	}
-    // set previous position to current position
-    e->prev_position = e->position;
-	//force multiplied by inverse mass to get realism of interaction between cloth mass, gravity and forces
-	e->position += e->velocity + ((e->forces * (1.0 / e->mass)) + e->gravity) * pow(dt, 2);
-    
-    e->forces = dvec3(0);
-    if (e->position.y <= 0.0f) {
+  // on the new positions, so a folding cloth can't step through itself
+  if (selfCollision) {
+    selfCollision->Step(GetParticles(), pool, sleepTiles);
+  }
+  if (!sleepDeferred) {
+    UpdateSleep(dt);
+  }
+}
+
+//larger of m and x, where a NaN is larger than anything so a blown up particle can't hide
+static float larger(float m, float x) { return m != m || x <= m ? m : x; }
+
+//largest of measure(begin, end) over [0, count), in jobs
+template <typename F> static float largest(size_t count, const F &measure) {
+  const size_t chunks = JobPool::Chunks(count, measureGrain);
+  if (chunkMax.size() < chunks) {
+    chunkMax.resize(chunks);
+  }
+  GetJobPool().ParallelFor(chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      chunkMax[k] = measure(k * measureGrain, std::min((k + 1) * measureGrain, count));
     }
+  });
+  float m = 0.0f;
+  for (size_t k = 0; k < chunks; ++k) {
+    m = larger(m, chunkMax[k]);
   }
+  return m;
+}
+
+float MaxStrainChange() {
+  if (!springs) {
+    return 0.0f;
+  }
+  const ParticleStore &ps = GetParticles();
+  const SpringTopology &t = *springs;
+  return largest(t.Size(), [&](size_t begin, size_t end) {
+    float m = 0.0f;
+    for (size_t e = begin; e < end; ++e) {
+      const uint32_t i = t.a[e], j = t.b[e];
+      const float now = length(vec3(ps.px[j] - ps.px[i], ps.py[j] - ps.py[i], ps.pz[j] - ps.pz[i]));
+      const float before = length(vec3(ps.ox[j] - ps.ox[i], ps.oy[j] - ps.oy[i], ps.oz[j] - ps.oz[i]));
+      m = larger(m, fabs(now - before) / t.restLength[e]);
+    }
+    return m;
+  });
+}
+
+float MaxDisplacement() {
+  const ParticleStore &ps = GetParticles();
+  return largest(ps.Size(), [&](size_t begin, size_t end) {
+    float m = 0.0f;
+    for (size_t i = begin; i < end; ++i) {
+      m = larger(m, length(ps.Velocity(i)));
+    }
+    return m;
+  });
+}
+
+void SyncTransforms() {
+  const ParticleStore &ps = GetParticles();
+  // every particle has its own entity, so the copies are independent
+  GetJobPool().ParallelFor(ps.Size(), syncGrain, [&ps](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Entity *e = ps.owner[i] ? ps.owner[i]->GetParent() : nullptr;
+      if (e) {
+        e->SetPosition(ps.Position(i));
+      }
+    }
+  });
 }
 
 void InitPhysics() {}
@@ -138,67 +405,30 @@ cRigidBody::~cRigidBody() {}
 
 void cRigidBody::Update(double delta) {}
 
-cCollider::cCollider(const std::string &tag) : Component(tag) { colliders.push_back(this); }
+cCollider::cCollider(const char *tag, ColliderShape s) : Component(tag), shape(s) {}
 
-cCollider::~cCollider() {
-  auto position = std::find(colliders.begin(), colliders.end(), this);
-  if (position != colliders.end()) {
-    colliders.erase(position);
-  }
-}
+cCollider::~cCollider() {}
 
 void cCollider::Update(double delta) {}
 
-cSphereCollider::cSphereCollider() : radius(0.3), cCollider("SphereCollider") {}
+cSphereCollider::cSphereCollider() : cCollider("SphereCollider", SHAPE_SPHERE), radius(0.3), body_(nullptr), bodyKnown_(false) {}
 
 cSphereCollider::~cSphereCollider() {}
 
-cPlaneCollider::cPlaneCollider() : normal(dvec3(0, 1.0, 0)), cCollider("PlaneCollider") {}
+cPhysics *cSphereCollider::GetBody() {
+  if (!bodyKnown_ && Ent_) {
+    body_ = Ent_->getComponent<cPhysics>();
+    bodyKnown_ = true;
+  }
+  return body_;
+}
+
+cPlaneCollider::cPlaneCollider() : cCollider("PlaneCollider", SHAPE_PLANE), normal(dvec3(0, 1.0, 0)) {}
 
 cPlaneCollider::~cPlaneCollider() {}
 
 //Spring constructor
-cSpring::cSpring(cPhysics *other, cPhysics *p, float sc, float rl, float damper, phys::RGBAInt32 c) : b(p), a(other), springConstant(sc), restLength(rl), dampingFactor(damper), col(c)
+cSpring::cSpring(cPhysics *other, cPhysics *p, float sc, float rl, float damper, phys::RGBAInt32 c) : a(other), b(p), col(c), springConstant(sc), dampingFactor(damper), restLength(rl)
 {
 }
 
-//Spring update method, calculates all the physics
-void cSpring::update()
-{
-
-	//force is position of the second particle - position of the first particle
-	vec3 force = b->position;
-	force -= a->position;
-
-	//calculation force magnitude
-	float magnitude = length(force);
-	//magnitude of the force - the rest length of the spring
-	magnitude = magnitude - restLength;
-	//magnitude * the spring constant
-	magnitude *= springConstant;
-
-	//normalizing force
-	force = normalize(force);
-	//force * -magnitude of the force
-	force *= -magnitude;
-
-
-	//calculating damper force asa velocity of second particle - velocity of first particle
-	vec3 dampForce = b->velocity - a->velocity;
-	//damp force vector * the damping factor
-	dampForce *= dampingFactor;
-	//contrasting force of spring with damper : force - damper force
-	force -= dampForce;
-
-	//adding forces to both particles
-	b->AddImpulse(force);
-	a->AddImpulse(-force);
-
-}
-
-//For testing - renders all the springs and makes them visible and coloured
-void cSpring::Render()
-{
-	//spring is rendered as a line
-	phys::DrawLine(this->a->position, this->b->position, false, this->col);
-}
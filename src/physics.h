@@ -1,18 +1,29 @@
 #pragma once
 #include "game.h"
+#include "particles.h"
+#include "springs.h"
 
+class SelfCollision;
+class SleepTiles;
+struct ImplicitStats;
+
+//Handle to a particle in the particle store
 class cPhysics : public Component {
 public:
   cPhysics();
   ~cPhysics();
-  glm::vec3 position;
-  glm::vec3 prev_position;
-  glm::dvec3 velocity;
-  glm::dvec3 forces;
-  //gravity is set in the particle so it can be modified
-  glm::dvec3 gravity = glm::dvec3(0, -10.0, 0);
-  double mass;
-  bool fixed = false;
+  //slot of this particle in the particle store
+  size_t index;
+  glm::vec3 GetPosition() const;
+  void SetPosition(const glm::vec3 &p);
+  glm::vec3 GetPrevPosition() const;
+  void SetPrevPosition(const glm::vec3 &p);
+  //displacement over the last tick
+  glm::vec3 GetVelocity() const;
+  double GetMass() const;
+  void SetMass(double m);
+  bool IsFixed() const;
+  void SetFixed(bool b);
   virtual void Update(double delta);
   virtual void SetParent(Entity *p);
   virtual void AddImpulse(const glm::vec3 &i);
@@ -50,8 +61,6 @@ class cSpring
 public:
 	//spring constructor passing second particle and first particle, with all the constants and the colour
 	cSpring(cPhysics *particle, cPhysics *other, float springConstant, float restLength, float damping, phys::RGBAInt32 col);
-	//method to update the spring that does all the spring physics calculations
-	virtual void update();
 	//for testing - renders the spring as a line
 	void Render();
 };
@@ -65,9 +74,13 @@ public:
 private:
 };
 
+//shape tag of a collider, used to dispatch collision tests without casts
+enum ColliderShape { SHAPE_SPHERE, SHAPE_PLANE, SHAPE_COUNT };
+
 class cCollider : public Component {
 public:
-  cCollider(const std::string &tag);
+  const ColliderShape shape;
+  cCollider(const char *tag, ColliderShape shape);
   ~cCollider();
   void Update(double delta);
 
@@ -80,8 +93,12 @@ public:
   double radius;
   cSphereCollider();
   ~cSphereCollider();
+  //physics component of the same entity, looked up on first use (nullptr if there is none)
+  cPhysics *GetBody();
 
 private:
+  cPhysics *body_;
+  bool bodyKnown_;
 };
 
 class cPlaneCollider : public cCollider {
@@ -93,14 +110,43 @@ public:
 private:
 };
 
-struct collisionInfo {
-  const cCollider *c1;
-  const cCollider *c2;
-  const glm::dvec3 position;
-  const glm::dvec3 normal;
-  const double depth;
-};
-
 void InitPhysics();
 void ShutdownPhysics();
 void UpdatePhysics(const double t, const double dt);
+//how violent the last step was: the largest change of strain (length / rest length) of any spring set with
+//SetSprings, and the largest distance any particle moved. Both are read from the current and previous positions.
+float MaxStrainChange();
+float MaxDisplacement();
+//copies every particle position to its entity in one pass, call it once per frame before Entity::GetPosition is read.
+//The physics only reads the particle store, so it can be skipped when nothing else needs the entity positions.
+void SyncTransforms();
+//springs evaluated at the start of every tick, the params can be changed at any time (nullptr for none)
+void SetSprings(const SpringTopology *springs, const SpringParams *params);
+//the springs' particles are a rows x rows grid from store slot first, x * rows + z (rows 0 for none), for multigrid
+void SetSolverGrid(uint32_t first, size_t rows);
+//self collision run on the integrated positions of every tick (nullptr for none)
+void SetSelfCollision(SelfCollision *selfCollision);
+//regions of the cloth that fall asleep once they stop moving and are skipped by the tick (nullptr for none).
+//Forces (AddImpulse, SetMass), contacts with something awake and changes to gravity or the spring constants wake them.
+void SetSleep(SleepTiles *sleep);
+//while deferred, UpdatePhysics leaves the sleep tiles alone and the caller runs UpdateSleep for each step it keeps,
+//so a step thrown away can't put anything to sleep or count towards it
+void DeferSleep(bool defer);
+void UpdateSleep(const double dt);
+
+//how the springs act on the particles: as forces before the Verlet step, as XPBD distance constraints on the
+//positions it predicted, or through a backward Euler step in place of the Verlet step, its linear system solved with
+//conjugate gradient alone or with multigrid over the cloth grid. All but the first are stable at any stiffness and
+//tick length, their cost grows with the iterations; multigrid keeps the iterations flat as the grid grows.
+enum SolverKind { SOLVER_SPRINGS, SOLVER_XPBD, SOLVER_IMPLICIT, SOLVER_MULTIGRID, SOLVER_KINDS };
+//the solver can be switched between ticks
+void SetSolver(SolverKind kind);
+SolverKind GetSolver();
+const char *SolverName(SolverKind kind);
+//constraint passes per tick of the XPBD solver
+void SetSolverIterations(int iterations);
+int GetSolverIterations();
+//conjugate gradient steps per tick of the implicit solver at most, and the residual it stops at (relative)
+void SetImplicitLimits(int maxIterations, float tolerance);
+//iterations and residual of the last implicit tick
+const ImplicitStats &GetImplicitStats();
@@ -0,0 +1,145 @@
+#include "pipeline.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+//seconds on a monotonic clock, shared by both threads
+static double now() {
+  return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SnapshotBuffer::SnapshotBuffer() : middle_(1), back_(0), front_(2) {}
+
+void SnapshotBuffer::Reserve(size_t count) {
+  for (Snapshot &s : buffers_) {
+    s.positions.reserve(count);
+    s.previous.reserve(count);
+  }
+}
+
+void SnapshotBuffer::Publish() {
+  // release: the reader sees everything written to the buffer before it sees the index
+  back_ = middle_.exchange(back_ | freshBit, memory_order_acq_rel) & ~freshBit;
+}
+
+const Snapshot &SnapshotBuffer::Read(bool &fresh) {
+  fresh = (middle_.load(memory_order_relaxed) & freshBit) != 0;
+  if (fresh) {
+    front_ = middle_.exchange(front_, memory_order_acq_rel) & ~freshBit;
+  }
+  return buffers_[front_];
+}
+
+SimPipeline::SimPipeline(FixedStepScheduler &scheduler)
+    : scheduler_(scheduler), capture_(nullptr), running_(false), published_(0), consumed_(0), lastLatency_(0.0),
+      totalLatency_(0.0), maxLatency_(0.0) {}
+
+SimPipeline::~SimPipeline() { Stop(); }
+
+void SimPipeline::Start() {
+  if (running_) {
+    return;
+  }
+  // the renderer has something to draw from the first frame
+  buffer_.Reserve(GetParticles().Size());
+  Publish();
+  running_ = true;
+  thread_ = thread(&SimPipeline::Run, this);
+}
+
+void SimPipeline::Stop() {
+  if (!running_) {
+    return;
+  }
+  running_ = false;
+  thread_.join();
+  RunCommands();
+}
+
+void SimPipeline::Post(const function<void()> &fn) {
+  if (!running_) {
+    fn();
+    return;
+  }
+  lock_guard<mutex> lock(commandsMutex_);
+  commands_.push_back(fn);
+}
+
+void SimPipeline::RunCommands() {
+  {
+    lock_guard<mutex> lock(commandsMutex_);
+    commands_.swap(runningCommands_);
+  }
+  for (auto &fn : runningCommands_) {
+    fn();
+  }
+  runningCommands_.clear();
+}
+
+void SimPipeline::Publish() {
+  Snapshot &s = buffer_.Back();
+  const ParticleStore &ps = GetParticles();
+  const size_t count = ps.Size();
+  s.positions.resize(count);
+  s.previous.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    s.positions[i] = ps.Position(i);
+    s.previous[i] = scheduler_.PreviousPosition(i);
+  }
+  s.stats = scheduler_.Stats();
+  s.time = scheduler_.Time();
+  s.tickLength = scheduler_.TickLength();
+  if (capture_) {
+    capture_(s);
+  }
+  s.publishedAt = now();
+  buffer_.Publish();
+  ++published_;
+}
+
+void SimPipeline::Run() {
+  double last = now();
+  while (running_) {
+    RunCommands();
+    const double t = now();
+    const int ticks = scheduler_.Advance(t - last);
+    last = t;
+    if (ticks) {
+      Publish();
+    } else {
+      // nothing due, sleep until the next tick is
+      const double wait = (1.0 - min(scheduler_.Alpha(), 1.0)) * scheduler_.TickLength();
+      this_thread::sleep_for(chrono::duration<double>(wait));
+    }
+  }
+}
+
+const Snapshot &SimPipeline::Latest() {
+  bool fresh;
+  const Snapshot &s = buffer_.Read(fresh);
+  if (fresh) {
+    lastLatency_ = now() - s.publishedAt;
+    totalLatency_ += lastLatency_;
+    maxLatency_ = max(maxLatency_, lastLatency_);
+    ++consumed_;
+  }
+  return s;
+}
+
+float SimPipeline::Alpha(const Snapshot &snapshot) const {
+  if (snapshot.tickLength <= 0.0) {
+    return 1.0f;
+  }
+  return static_cast<float>(min(max((now() - snapshot.publishedAt) / snapshot.tickLength, 0.0), 1.0));
+}
+
+PipelineStats SimPipeline::Stats() const {
+  PipelineStats stats;
+  stats.published = published_;
+  stats.consumed = consumed_;
+  stats.lastLatencyMs = lastLatency_ * 1000.0;
+  stats.averageLatencyMs = consumed_ ? totalLatency_ * 1000.0 / consumed_ : 0.0;
+  stats.maxLatencyMs = maxLatency_ * 1000.0;
+  return stats;
+}
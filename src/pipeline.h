@@ -0,0 +1,108 @@
+#pragma once
+#include "scheduler.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//State of the simulation at the end of one tick, as the renderer sees it. Never written while the renderer holds it.
+struct Snapshot {
+  //particle positions by store slot, at the last tick and at the one before it
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> previous;
+  //whatever the capture function wants the renderer to see (window title values...)
+  std::vector<double> values;
+  SchedulerStats stats;
+  double time;
+  double tickLength;
+  //when the simulation thread published it, in seconds on the pipeline clock
+  double publishedAt;
+
+  Snapshot() : time(0.0), tickLength(0.0), publishedAt(0.0) {}
+  //position of slot i between the last two ticks, alpha 0 is the older one
+  glm::vec3 Position(size_t i, float alpha) const { return previous[i] + (positions[i] - previous[i]) * alpha; }
+};
+
+//Triple buffer handing snapshots from one writer thread to one reader thread without locks.
+//The writer fills its back buffer and swaps it with the middle one, the reader swaps the middle one with its front
+//buffer when the middle one is newer. Both swaps are a single atomic exchange of the middle index.
+class SnapshotBuffer {
+public:
+  SnapshotBuffer();
+  //buffer the writer fills next
+  Snapshot &Back() { return buffers_[back_]; }
+  //sizes all three buffers for count particles, so none of them allocates the first time it is filled
+  void Reserve(size_t count);
+  //makes the back buffer the newest snapshot
+  void Publish();
+  //newest snapshot, valid until the next Read; fresh tells if it wasn't returned before
+  const Snapshot &Read(bool &fresh);
+
+private:
+  //set in the middle index when it holds a snapshot the reader hasn't taken
+  static const uint32_t freshBit = 4;
+  Snapshot buffers_[3];
+  std::atomic<uint32_t> middle_;
+  uint32_t back_;
+  uint32_t front_;
+};
+
+//how far behind the simulation the renderer is
+struct PipelineStats {
+  //snapshots published by the simulation and picked up by the renderer, the difference was never drawn
+  uint64_t published;
+  uint64_t consumed;
+  //time from a snapshot being published to the renderer picking it up
+  double lastLatencyMs;
+  double averageLatencyMs;
+  double maxLatencyMs;
+};
+
+//Runs the scheduler on its own thread, so ticks keep going while the main thread draws the last snapshot.
+//Everything else that touches the simulation (input, parameter changes) is posted as a command and runs on the
+//simulation thread before its next tick.
+class SimPipeline {
+public:
+  //fills the values of a snapshot, on the simulation thread
+  typedef void (*CaptureFn)(Snapshot &snapshot);
+
+  explicit SimPipeline(FixedStepScheduler &scheduler);
+  ~SimPipeline();
+  void SetCapture(CaptureFn capture) { capture_ = capture; }
+  //publishes a first snapshot and starts the simulation thread
+  void Start();
+  //stops the simulation thread and runs the commands it left behind
+  void Stop();
+  bool Running() const { return running_; }
+  //runs fn on the simulation thread before its next tick, or right away when the pipeline isn't running
+  void Post(const std::function<void()> &fn);
+
+  //newest snapshot, valid until the next call; main thread only
+  const Snapshot &Latest();
+  //alpha to draw a snapshot with, from the time since it was published
+  float Alpha(const Snapshot &snapshot) const;
+  PipelineStats Stats() const;
+
+private:
+  void Run();
+  void RunCommands();
+  void Publish();
+
+  FixedStepScheduler &scheduler_;
+  CaptureFn capture_;
+  SnapshotBuffer buffer_;
+  std::thread thread_;
+  std::atomic<bool> running_;
+  std::mutex commandsMutex_;
+  std::vector<std::function<void()>> commands_;
+  //commands being run, swapped with commands_ so posting never waits for them
+  std::vector<std::function<void()>> runningCommands_;
+  std::atomic<uint64_t> published_;
+  uint64_t consumed_;
+  double lastLatency_;
+  double totalLatency_;
+  double maxLatency_;
+};
@@ -0,0 +1,44 @@
+#include "game.h"
+#include "physics.h"
+#include <phys_utils.h>
+
+//Render side of the components. Kept out of the physics core so it can be built without GL.
+
+//############## Shape Renderer ###################
+
+void cShapeRenderer::SetColour(const phys::RGBAInt32 c) { col_ = c; }
+
+phys::RGBAInt32 cShapeRenderer::GetColour() const { return col_; }
+
+cShapeRenderer::cShapeRenderer(SHAPES s) : shape(s), col_(RED), Component("ShapeRenderer") {}
+
+cShapeRenderer::~cShapeRenderer() {}
+
+void cShapeRenderer::Update(double delta) {}
+
+void cShapeRenderer::Render() {
+  switch (shape) {
+  case SPHERE: {
+	  //radius of the sphere has been removed, recorded into the batch drawn at the end of the frame
+    const glm::vec3 p = Ent_->GetPosition();
+    phys::DrawSpheres(&p, 1, 0.05f, nullptr, col_);
+    break;
+  }
+  case BOX:
+    phys::DrawCube(Ent_->GetPosition(), Ent_->GetScale(), col_);
+    break;
+  default: {
+    const glm::vec3 p = Ent_->GetPosition();
+    phys::DrawSpheres(&p, 1, 0.05f, nullptr, col_);
+    break;
+  }
+  }
+}
+
+//For testing - renders all the springs and makes them visible and coloured
+void cSpring::Render()
+{
+	//spring is rendered as a line, batched with all the other lines of the frame
+	const std::pair<glm::vec3, glm::vec3> line(this->a->GetPosition(), this->b->GetPosition());
+	phys::DrawLines(&line, 1, false, this->col);
+}
@@ -0,0 +1,185 @@
+#include "scheduler.h"
+#include "physics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+
+//a frame of exactly n ticks must run n ticks, even when rounding left the accumulator a hair short
+static const double tickTolerance = 1.0e-9;
+//an adaptive step grows back once it stays under this fraction of both limits, so the doubled step stays under them
+static const float growFraction = 0.5f;
+
+FixedStepScheduler::FixedStepScheduler(double ticksPerSecond, int substeps, int maxTicksPerFrame)
+    : tick_(1.0 / 60.0), substeps_(1), maxTicks_(1), step_(UpdatePhysics), adaptive_(false), level_(0), lastDt_(0.0),
+      accumulator_(0.0), time_(0.0) {
+  const AdaptiveLimits limits = {0.2f, 0.2f, 6};
+  SetAdaptiveLimits(limits);
+  SetTicksPerSecond(ticksPerSecond);
+  SetSubsteps(substeps);
+  SetMaxTicksPerFrame(maxTicksPerFrame);
+  ResetStats();
+}
+
+void FixedStepScheduler::SetTicksPerSecond(double ticksPerSecond) {
+  if (ticksPerSecond > 0.0) {
+    tick_ = 1.0 / ticksPerSecond;
+  }
+}
+
+void FixedStepScheduler::SetSubsteps(int substeps) { substeps_ = max(substeps, 1); }
+
+void FixedStepScheduler::SetMaxTicksPerFrame(int ticks) { maxTicks_ = max(ticks, 1); }
+
+void FixedStepScheduler::SetAdaptiveLimits(const AdaptiveLimits &limits) {
+  limits_ = limits;
+  limits_.maxHalvings = min(max(limits.maxHalvings, 0), AdaptiveStats::levels - 1);
+  level_ = min(level_, limits_.maxHalvings);
+}
+
+void FixedStepScheduler::ResetStats() {
+  stats_.frames = 0;
+  stats_.ticks = 0;
+  stats_.substeps = 0;
+  stats_.cappedFrames = 0;
+  stats_.droppedTime = 0.0;
+  stats_.lastStepMs = 0.0;
+  stats_.averageStepMs = 0.0;
+  stats_.maxStepMs = 0.0;
+  totalStepMs_ = 0.0;
+  adaptiveStats_.steps = 0;
+  adaptiveStats_.rollbacks = 0;
+  adaptiveStats_.overLimit = 0;
+  fill(adaptiveStats_.histogram, adaptiveStats_.histogram + AdaptiveStats::levels, uint64_t(0));
+  adaptiveStats_.lastStrain = 0.0f;
+  adaptiveStats_.lastDisplacement = 0.0f;
+}
+
+void FixedStepScheduler::RunStep(double dt) {
+  // the store keeps a particle's velocity as the distance it moved in the last step, which has to be scaled to
+  // the new step size or changing it would change the speed of the cloth
+  if (lastDt_ > 0.0 && dt != lastDt_) {
+    ParticleStore &ps = GetParticles();
+    const float scale = static_cast<float>(dt / lastDt_);
+    for (size_t i = 0; i < ps.Size(); ++i) {
+      ps.ox[i] = ps.px[i] - (ps.px[i] - ps.ox[i]) * scale;
+      ps.oy[i] = ps.py[i] - (ps.py[i] - ps.oy[i]) * scale;
+      ps.oz[i] = ps.pz[i] - (ps.pz[i] - ps.oz[i]) * scale;
+    }
+  }
+  step_(time_, dt);
+  lastDt_ = dt;
+}
+
+void FixedStepScheduler::RunFixedTick() {
+  const double subDt = tick_ / substeps_;
+  for (int s = 0; s < substeps_; ++s) {
+    RunStep(subDt);
+    time_ += subDt;
+  }
+  stats_.substeps += substeps_;
+}
+
+void FixedStepScheduler::RunAdaptiveTick() {
+  ParticleStore &ps = GetParticles();
+  vector<float> *state[9] = {&ps.px, &ps.py, &ps.pz, &ps.ox, &ps.oy, &ps.oz, &ps.fx, &ps.fy, &ps.fz};
+  // progress through the tick in steps of the smallest size, so the steps add up to exactly one tick
+  const int units = 1 << limits_.maxHalvings;
+  int done = 0;
+  // the sleep tiles aren't part of the saved state, so they only hear of the steps that are kept
+  DeferSleep(true);
+  while (done < units) {
+    for (int k = 0; k < 9; ++k) {
+      saved_[k].assign(state[k]->begin(), state[k]->end());
+    }
+    const double savedDt = lastDt_;
+    double dt;
+    float strain, displacement;
+    for (;;) {
+      dt = tick_ / (1 << level_);
+      RunStep(dt);
+      strain = MaxStrainChange();
+      displacement = MaxDisplacement();
+      // written so that a NaN is over the limits too
+      const bool over = !(strain <= limits_.maxStrain && displacement <= limits_.maxDisplacement);
+      if (!over || level_ == limits_.maxHalvings) {
+        adaptiveStats_.overLimit += over;
+        break;
+      }
+      // too far for one step: put the particles back and try half of it
+      for (int k = 0; k < 9; ++k) {
+        state[k]->assign(saved_[k].begin(), saved_[k].end());
+      }
+      lastDt_ = savedDt;
+      ++level_;
+      ++adaptiveStats_.rollbacks;
+    }
+    UpdateSleep(dt);
+    const int size = units >> level_;
+    done += size;
+    time_ += dt;
+    ++stats_.substeps;
+    ++adaptiveStats_.steps;
+    ++adaptiveStats_.histogram[level_];
+    adaptiveStats_.lastStrain = strain;
+    adaptiveStats_.lastDisplacement = displacement;
+    // double the step once the cloth has calmed down, when the bigger step starts on a multiple of its size
+    if (level_ > 0 && strain < limits_.maxStrain * growFraction &&
+        displacement < limits_.maxDisplacement * growFraction && done % (size * 2) == 0) {
+      --level_;
+    }
+  }
+  DeferSleep(false);
+}
+
+int FixedStepScheduler::Advance(double frameTime) {
+  ++stats_.frames;
+  accumulator_ += max(frameTime, 0.0);
+  int ticks = 0;
+  while (accumulator_ + tick_ * tickTolerance >= tick_) {
+    if (ticks == maxTicks_) {
+      // over budget: keep the fraction of a tick for alpha and drop the whole ticks
+      const double dropped = floor(accumulator_ / tick_ + tickTolerance) * tick_;
+      accumulator_ = max(accumulator_ - dropped, 0.0);
+      stats_.droppedTime += dropped;
+      ++stats_.cappedFrames;
+      break;
+    }
+    // positions before the tick, to interpolate from
+    const ParticleStore &ps = GetParticles();
+    lastX_.assign(ps.px.begin(), ps.px.end());
+    lastY_.assign(ps.py.begin(), ps.py.end());
+    lastZ_.assign(ps.pz.begin(), ps.pz.end());
+
+    const auto t0 = chrono::high_resolution_clock::now();
+    if (adaptive_) {
+      RunAdaptiveTick();
+    } else {
+      RunFixedTick();
+    }
+    const double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - t0).count();
+    accumulator_ = max(accumulator_ - tick_, 0.0);
+    ++ticks;
+    ++stats_.ticks;
+    stats_.lastStepMs = ms;
+    stats_.maxStepMs = max(stats_.maxStepMs, ms);
+    totalStepMs_ += ms;
+    stats_.averageStepMs = totalStepMs_ / stats_.ticks;
+  }
+  return ticks;
+}
+
+glm::vec3 FixedStepScheduler::PreviousPosition(size_t i) const {
+  // particles added since the last tick have nothing older than their current position
+  if (i >= lastX_.size()) {
+    return GetParticles().Position(i);
+  }
+  return glm::vec3(lastX_[i], lastY_[i], lastZ_[i]);
+}
+
+glm::vec3 FixedStepScheduler::RenderPosition(size_t i) const {
+  const glm::vec3 current = GetParticles().Position(i);
+  const glm::vec3 last = PreviousPosition(i);
+  return last + (current - last) * static_cast<float>(min(Alpha(), 1.0));
+}
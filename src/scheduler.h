@@ -0,0 +1,117 @@
+#pragma once
+#include "particles.h"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+//what the scheduler has done since its stats were last reset
+struct SchedulerStats {
+  //frames advanced, ticks run and substeps run (steps of any size in adaptive mode)
+  uint64_t frames;
+  uint64_t ticks;
+  uint64_t substeps;
+  //frames that hit the catch-up cap, and the simulated time they threw away
+  uint64_t cappedFrames;
+  double droppedTime;
+  //wall time of one tick (all its substeps), last, average and worst
+  double lastStepMs;
+  double averageStepMs;
+  double maxStepMs;
+};
+
+//when an adaptive step is too big: the largest change of spring strain and the largest distance a particle may
+//move in one step, and how many times the tick may be halved to stay under them
+struct AdaptiveLimits {
+  float maxStrain;
+  float maxDisplacement;
+  int maxHalvings;
+};
+
+//what the adaptive steps have done since the stats were last reset
+struct AdaptiveStats {
+  //step sizes, tick / 2^0 down to tick / 2^(levels - 1)
+  static const int levels = 8;
+  //steps kept, steps thrown away and run again smaller, and steps kept over the limits at the smallest size
+  uint64_t steps;
+  uint64_t rollbacks;
+  uint64_t overLimit;
+  //steps kept of each size, histogram[k] counts the steps of tick / 2^k
+  uint64_t histogram[levels];
+  //strain change and displacement of the last step kept
+  float lastStrain;
+  float lastDisplacement;
+};
+
+//Fixed timestep scheduler: real frame time goes into an accumulator, and whole ticks of 1 / ticks per second
+//are taken out of it and run as a number of equal substeps. At most maxTicksPerFrame ticks run per frame, time
+//beyond that is dropped, so a stall slows the simulation down instead of making every later frame slower.
+//The leftover fraction of a tick is the alpha used to interpolate render positions between the last two ticks.
+//In adaptive mode a tick runs as steps of tick / 2^k instead of equal substeps: a step that moves the cloth more than
+//the limits allow is rolled back and run again at half the size, and the size doubles again once steps stay well
+//under the limits. Steps never get longer than the tick, so adaptive mode only ever adds steps: it is a guard for
+//motion too violent for the tick (off by default), not a saving. A cloth at rest gets cheap by sleeping instead.
+class FixedStepScheduler {
+public:
+  //one substep of dt seconds starting at simulated time t
+  typedef void (*StepFn)(double t, double dt);
+
+  FixedStepScheduler(double ticksPerSecond = 60.0, int substeps = 1, int maxTicksPerFrame = 5);
+
+  void SetTicksPerSecond(double ticksPerSecond);
+  double TicksPerSecond() const { return 1.0 / tick_; }
+  double TickLength() const { return tick_; }
+  void SetSubsteps(int substeps);
+  int Substeps() const { return substeps_; }
+  void SetMaxTicksPerFrame(int ticks);
+  int MaxTicksPerFrame() const { return maxTicks_; }
+  //what a substep runs, UpdatePhysics by default
+  void SetStep(StepFn step) { step_ = step; }
+  void SetAdaptive(bool adaptive) { adaptive_ = adaptive; }
+  bool Adaptive() const { return adaptive_; }
+  void SetAdaptiveLimits(const AdaptiveLimits &limits);
+  const AdaptiveLimits &GetAdaptiveLimits() const { return limits_; }
+
+  //adds frameTime seconds of real time and runs the ticks it pays for, returns how many ran
+  int Advance(double frameTime);
+
+  //length of the last step run, 0 before the first one
+  double LastStep() const { return lastDt_; }
+  //simulated time, at the end of the last tick
+  double Time() const { return time_; }
+  //how far into the next tick real time is, 0 to 1
+  double Alpha() const { return accumulator_ / tick_; }
+  //position of particle slot i between the last two ticks, by alpha
+  glm::vec3 RenderPosition(size_t i) const;
+  //position of particle slot i before the last tick
+  glm::vec3 PreviousPosition(size_t i) const;
+
+  const SchedulerStats &Stats() const { return stats_; }
+  const AdaptiveStats &GetAdaptiveStats() const { return adaptiveStats_; }
+  void ResetStats();
+
+private:
+  void RunFixedTick();
+  void RunAdaptiveTick();
+  //runs one step of dt, first rescaling the particle velocities from the step before when its size differs
+  void RunStep(double dt);
+
+  double tick_;
+  int substeps_;
+  int maxTicks_;
+  StepFn step_;
+  bool adaptive_;
+  AdaptiveLimits limits_;
+  //halvings of the current adaptive step, and the size of the last step run
+  int level_;
+  double lastDt_;
+  double accumulator_;
+  double time_;
+  double totalStepMs_;
+  SchedulerStats stats_;
+  AdaptiveStats adaptiveStats_;
+  //particle positions before the last tick
+  std::vector<float> lastX_, lastY_, lastZ_;
+  //particle state before the adaptive step being tried
+  std::vector<float> saved_[9];
+};
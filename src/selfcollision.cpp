@@ -0,0 +1,154 @@
+#include "selfcollision.h"
+#include "sleep.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+//candidate pairs reserved per particle: a cloth folded flat onto itself has one for every two particles, this leaves
+//room for a few folds on top of each other without the steps allocating
+static const size_t reservedPairs = 2;
+//particles searched per job
+static const size_t findGrain = 1024;
+
+SelfCollision::SelfCollision() : first_(0), count_(0), thickness_(0.0f), candidates_(0), excluded_(0) {}
+
+void SelfCollision::Init(const SpringTopology &springs, uint32_t first, uint32_t count, float thickness) {
+  first_ = first;
+  count_ = count;
+  thickness_ = thickness;
+  candidates_ = 0;
+  excluded_ = 0;
+  radius_.assign(count, thickness * 0.5f);
+  const size_t chunks = JobPool::Chunks(count, findGrain);
+  chunkPairs_.resize(chunks);
+  chunkExcluded_.assign(chunks, 0);
+  for (vector<SpherePair> &pairs : chunkPairs_) {
+    pairs.clear();
+    pairs.reserve(findGrain * reservedPairs);
+  }
+
+  // adjacency of the springs inside the range, counted then filled in place
+  start_.assign(count + 1, 0);
+  for (size_t e = 0; e < springs.Size(); ++e) {
+    const uint32_t a = springs.a[e] - first;
+    const uint32_t b = springs.b[e] - first;
+    if (a < count && b < count) {
+      ++start_[a + 1];
+      ++start_[b + 1];
+    }
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    start_[i + 1] += start_[i];
+  }
+  neighbours_.resize(start_[count]);
+  vector<uint32_t> fill(start_.begin(), start_.end() - 1);
+  for (size_t e = 0; e < springs.Size(); ++e) {
+    const uint32_t a = springs.a[e] - first;
+    const uint32_t b = springs.b[e] - first;
+    if (a < count && b < count) {
+      neighbours_[fill[a]++] = b;
+      neighbours_[fill[b]++] = a;
+    }
+  }
+}
+
+bool SelfCollision::Neighbours(uint32_t i, uint32_t j) const {
+  // a cloth particle has a dozen springs at most, a linear scan beats anything fancier
+  for (uint32_t k = start_[i]; k < start_[i + 1]; ++k) {
+    if (neighbours_[k] == j) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t SelfCollision::Step(ParticleStore &ps, JobPool &pool, SleepTiles *sleep) {
+  if (!count_ || first_ + count_ > ps.Size()) {
+    return 0;
+  }
+  // the store is already structure of arrays, the grid bins the cloth's slice of it directly
+  grid_.Build(&ps.px[first_], &ps.py[first_], &ps.pz[first_], radius_.data(), count_);
+  const size_t chunks = chunkPairs_.size();
+  pool.ParallelFor(chunks, 1, [this](size_t begin, size_t end) {
+    for (size_t k = begin; k < end; ++k) {
+      vector<SpherePair> &pairs = chunkPairs_[k];
+      pairs.clear();
+      grid_.FindPairs(pairs, k * findGrain, std::min((k + 1) * findGrain, size_t(count_)));
+      // spring neighbours dropped in place, the rest keep their order
+      size_t kept = 0;
+      for (const SpherePair &p : pairs) {
+        if (!Neighbours(p.a, p.b)) {
+          pairs[kept++] = p;
+        }
+      }
+      chunkExcluded_[k] = pairs.size() - kept;
+      pairs.resize(kept);
+    }
+  });
+
+  candidates_ = 0;
+  excluded_ = 0;
+  size_t contacts = 0;
+  const float minDist2 = thickness_ * thickness_;
+  // in range order, the order a single search over all the particles would give
+  for (size_t k = 0; k < chunks; ++k) {
+    excluded_ += chunkExcluded_[k];
+    candidates_ += chunkPairs_[k].size() + chunkExcluded_[k];
+    for (const SpherePair &p : chunkPairs_[k]) {
+      const size_t i = first_ + p.a;
+      const size_t j = first_ + p.b;
+      const float dx = ps.px[i] - ps.px[j];
+      const float dy = ps.py[i] - ps.py[j];
+      const float dz = ps.pz[i] - ps.pz[j];
+      const float d2 = dx * dx + dy * dy + dz * dz;
+      if (d2 >= minDist2 || d2 <= 0.0f) {
+        continue;
+      }
+      // like the other contacts: something awake touching a sleeping particle wakes its tile, and two sleeping
+      // ones stay asleep, held still like pinned ones below
+      if (sleep) {
+        const bool iAsleep = (ps.pinned[i] & PARTICLE_ASLEEP) != 0;
+        const bool jAsleep = (ps.pinned[j] & PARTICLE_ASLEEP) != 0;
+        if (iAsleep != jAsleep) {
+          sleep->Wake(ps, iAsleep ? i : j);
+        }
+      }
+      // pinned particles don't move, the other one takes the whole correction
+      const float wi = ps.pinned[i] ? 0.0f : ps.invMass[i];
+      const float wj = ps.pinned[j] ? 0.0f : ps.invMass[j];
+      const float w = wi + wj;
+      if (w <= 0.0f) {
+        continue;
+      }
+      const float d = sqrtf(d2);
+      const float nx = dx / d;
+      const float ny = dy / d;
+      const float nz = dz / d;
+      // relative velocity along the normal, only an approaching one is removed
+      const float vn = ((ps.px[i] - ps.ox[i]) - (ps.px[j] - ps.ox[j])) * nx +
+                       ((ps.py[i] - ps.oy[i]) - (ps.py[j] - ps.oy[j])) * ny +
+                       ((ps.pz[i] - ps.oz[i]) - (ps.pz[j] - ps.oz[j])) * nz;
+      const float stop = vn < 0.0f ? vn : 0.0f;
+      // the separation moves the previous position too, so pushing apart adds no velocity,
+      // while removing velocity only moves the previous position
+      const float push = thickness_ - d;
+      const float si = wi / w;
+      const float sj = wj / w;
+      ps.px[i] += nx * push * si;
+      ps.py[i] += ny * push * si;
+      ps.pz[i] += nz * push * si;
+      ps.ox[i] += nx * (push + stop) * si;
+      ps.oy[i] += ny * (push + stop) * si;
+      ps.oz[i] += nz * (push + stop) * si;
+      ps.px[j] -= nx * push * sj;
+      ps.py[j] -= ny * push * sj;
+      ps.pz[j] -= nz * push * sj;
+      ps.ox[j] -= nx * (push + stop) * sj;
+      ps.oy[j] -= ny * (push + stop) * sj;
+      ps.oz[j] -= nz * (push + stop) * sj;
+      ++contacts;
+    }
+  }
+  return contacts;
+}
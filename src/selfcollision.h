@@ -0,0 +1,48 @@
+#pragma once
+#include "broadphase.h"
+#include "jobs.h"
+#include "particles.h"
+#include "springs.h"
+#include <cstdint>
+#include <vector>
+
+class SleepTiles;
+
+//Self collision of a cloth: its particles are kept at least a thickness apart, found through the hashed
+//uniform grid so the cost per particle stays flat as the cloth grows.
+//Particles joined by a spring never collide, the spring already holds them and they are always close.
+//The grid search, most of the work, runs as jobs over ranges of particles, gathered in range order. The pairs are
+//then pushed apart one after the other on the main thread, each seeing the corrections of the ones before it, so
+//the result is the same whatever the number of threads.
+class SelfCollision {
+public:
+  SelfCollision();
+  //particles in store slots first to first + count - 1 collide with each other, the neighbours come from springs
+  void Init(const SpringTopology &springs, uint32_t first, uint32_t count, float thickness);
+  //pushes apart every pair closer than the thickness and removes their approaching velocity, returns the contacts.
+  //A sleeping particle touched by an awake one has its tile woken first, two sleeping ones are left alone.
+  size_t Step(ParticleStore &ps, JobPool &pool, SleepTiles *sleep = nullptr);
+
+  float Thickness() const { return thickness_; }
+  //candidate pairs of the last step, and how many of them were skipped as spring neighbours
+  size_t Pairs() const { return candidates_; }
+  size_t Excluded() const { return excluded_; }
+
+private:
+  bool Neighbours(uint32_t i, uint32_t j) const;
+
+  uint32_t first_;
+  uint32_t count_;
+  float thickness_;
+  size_t candidates_;
+  size_t excluded_;
+  UniformGrid grid_;
+  //half the thickness for every particle, the grid works on radii
+  std::vector<float> radius_;
+  //spring neighbours of particle i are neighbours_[start_[i]] to neighbours_[start_[i + 1] - 1], local indices
+  std::vector<uint32_t> start_;
+  std::vector<uint32_t> neighbours_;
+  //pairs of each range of particles that aren't spring neighbours, and how many were
+  std::vector<std::vector<SpherePair>> chunkPairs_;
+  std::vector<size_t> chunkExcluded_;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+//x86 SIMD support shared by the kernels: PHYS_X86 when SSE2/AVX2 intrinsics can be used,
+//PHYS_TARGET_AVX2 marks functions compiled for AVX2 (picked at runtime, see integrate.h)
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PHYS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PHYS_TARGET_AVX2
+#else
+#define PHYS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
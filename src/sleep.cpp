@@ -0,0 +1,212 @@
+#include "sleep.h"
+#include <algorithm>
+
+using namespace std;
+
+//tiles per job when measuring their energy
+static const size_t tileGrain = 16;
+
+SleepTiles::SleepTiles() : first_(0), rows_(0), tileRows_(1), side_(0), tiles_(0), energy_(1.0e-3f), ticks_(60) {
+  ResetStats();
+}
+
+void SleepTiles::Init(uint32_t first, uint32_t rows, uint32_t tileRows) {
+  first_ = first;
+  rows_ = rows;
+  tileRows_ = max<uint32_t>(tileRows, 1);
+  side_ = (rows_ + tileRows_ - 1) / tileRows_;
+  tiles_ = size_t(side_) * side_;
+  asleep_.assign(tiles_, 0);
+  calm_.assign(tiles_, 0);
+  tileEnergy_.assign(tiles_, 0.0f);
+  ResetStats();
+}
+
+void SleepTiles::SetThreshold(float energy, int ticks) {
+  energy_ = max(energy, 0.0f);
+  ticks_ = max(ticks, 1);
+}
+
+void SleepTiles::ResetStats() {
+  stats_.awakeParticles = Particles();
+  stats_.sleepingParticles = 0;
+  stats_.awakeTiles = tiles_;
+  stats_.sleepingTiles = 0;
+  stats_.sleeps = 0;
+  stats_.wakes = 0;
+  stats_.skippedTicks = 0;
+  for (size_t t = 0; t < tiles_; ++t) {
+    if (asleep_[t]) {
+      uint32_t x0, x1, z0, z1;
+      TileRange(t, x0, x1, z0, z1);
+      stats_.awakeParticles -= size_t(x1 - x0) * (z1 - z0);
+      stats_.sleepingParticles += size_t(x1 - x0) * (z1 - z0);
+      --stats_.awakeTiles;
+      ++stats_.sleepingTiles;
+    }
+  }
+}
+
+void SleepTiles::TileRange(size_t t, uint32_t &x0, uint32_t &x1, uint32_t &z0, uint32_t &z1) const {
+  x0 = static_cast<uint32_t>(t / side_) * tileRows_;
+  z0 = static_cast<uint32_t>(t % side_) * tileRows_;
+  x1 = min(x0 + tileRows_, rows_);
+  z1 = min(z0 + tileRows_, rows_);
+}
+
+void SleepTiles::Sleep(ParticleStore &ps, size_t t) {
+  uint32_t x0, x1, z0, z1;
+  TileRange(t, x0, x1, z0, z1);
+  for (uint32_t x = x0; x < x1; ++x) {
+    for (uint32_t z = z0; z < z1; ++z) {
+      // stopped where it is, so it wakes up standing still
+      const size_t i = first_ + size_t(x) * rows_ + z;
+      ps.ox[i] = ps.px[i];
+      ps.oy[i] = ps.py[i];
+      ps.oz[i] = ps.pz[i];
+      ps.pinned[i] |= PARTICLE_ASLEEP;
+    }
+  }
+  asleep_[t] = 1;
+  const size_t count = size_t(x1 - x0) * (z1 - z0);
+  stats_.awakeParticles -= count;
+  stats_.sleepingParticles += count;
+  --stats_.awakeTiles;
+  ++stats_.sleepingTiles;
+  ++stats_.sleeps;
+}
+
+void SleepTiles::WakeTile(ParticleStore &ps, size_t t) {
+  uint32_t x0, x1, z0, z1;
+  TileRange(t, x0, x1, z0, z1);
+  for (uint32_t x = x0; x < x1; ++x) {
+    for (uint32_t z = z0; z < z1; ++z) {
+      ps.pinned[first_ + size_t(x) * rows_ + z] &= ~PARTICLE_ASLEEP;
+    }
+  }
+  asleep_[t] = 0;
+  calm_[t] = 0;
+  tileEnergy_[t] = 0.0f;
+  const size_t count = size_t(x1 - x0) * (z1 - z0);
+  stats_.awakeParticles += count;
+  stats_.sleepingParticles -= count;
+  ++stats_.awakeTiles;
+  --stats_.sleepingTiles;
+  ++stats_.wakes;
+}
+
+void SleepTiles::Wake(ParticleStore &ps, size_t i) {
+  if (i < first_ || i - first_ >= Particles() || !(ps.pinned[i] & PARTICLE_ASLEEP)) {
+    return;
+  }
+  const size_t local = i - first_;
+  const size_t t = (local / rows_ / tileRows_) * side_ + (local % rows_) / tileRows_;
+  if (asleep_[t]) {
+    WakeTile(ps, t);
+  }
+}
+
+void SleepTiles::WakeAll(ParticleStore &ps) {
+  for (size_t t = 0; t < tiles_; ++t) {
+    if (asleep_[t]) {
+      WakeTile(ps, t);
+    }
+  }
+}
+
+void SleepTiles::FilterContacts(ContactBuffer &c, ParticleStore &ps) {
+  if (!stats_.sleepingTiles) {
+    return;
+  }
+  size_t kept = 0;
+  for (size_t k = 0; k < c.count; ++k) {
+    const int32_t a = c.bodyA[k], b = c.bodyB[k];
+    // static geometry counts as asleep: it can't disturb a particle that isn't moving, but a kinematic sphere can
+    const bool aAwake = a == BODY_KINEMATIC || (a >= 0 && !(ps.pinned[a] & PARTICLE_ASLEEP));
+    const bool bAwake = b == BODY_KINEMATIC || (b >= 0 && !(ps.pinned[b] & PARTICLE_ASLEEP));
+    if (!aAwake && !bAwake) {
+      continue;
+    }
+    if (a >= 0 && !aAwake) {
+      Wake(ps, a);
+    }
+    if (b >= 0 && !bAwake) {
+      Wake(ps, b);
+    }
+    c.bodyA[kept] = a;
+    c.bodyB[kept] = b;
+    c.nx[kept] = c.nx[k];
+    c.ny[kept] = c.ny[k];
+    c.nz[kept] = c.nz[k];
+    c.depth[kept] = c.depth[k];
+    ++kept;
+  }
+  c.count = kept;
+}
+
+float SleepTiles::TileEnergy(const ParticleStore &ps, size_t t, float dt2) const {
+  uint32_t x0, x1, z0, z1;
+  TileRange(t, x0, x1, z0, z1);
+  // a particle lying on something still falls for one tick before the contact stops it again, so up to one tick
+  // of gravity doesn't count as moving
+  const float gx = ps.gravity.x * dt2, gy = ps.gravity.y * dt2, gz = ps.gravity.z * dt2;
+  const float g2 = gx * gx + gy * gy + gz * gz;
+  float e = 0.0f;
+  for (uint32_t x = x0; x < x1; ++x) {
+    for (uint32_t z = z0; z < z1; ++z) {
+      const size_t i = first_ + size_t(x) * rows_ + z;
+      if (ps.invMass[i] <= 0.0f) {
+        continue;
+      }
+      float vx = ps.px[i] - ps.ox[i], vy = ps.py[i] - ps.oy[i], vz = ps.pz[i] - ps.oz[i];
+      const float fall = g2 > 0.0f ? min(max((vx * gx + vy * gy + vz * gz) / g2, 0.0f), 1.0f) : 0.0f;
+      vx -= fall * gx;
+      vy -= fall * gy;
+      vz -= fall * gz;
+      // 1/2 m v^2, written so that a NaN counts as moving
+      const float k = 0.5f * (vx * vx + vy * vy + vz * vz) / (dt2 * ps.invMass[i]);
+      e = k <= e ? e : k;
+    }
+  }
+  return e;
+}
+
+void SleepTiles::Update(ParticleStore &ps, float dt, JobPool &pool) {
+  if (!tiles_ || !(dt > 0.0f)) {
+    return;
+  }
+  const float dt2 = dt * dt;
+  pool.ParallelFor(tiles_, tileGrain, [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      if (!asleep_[t]) {
+        tileEnergy_[t] = TileEnergy(ps, t, dt2);
+      }
+    }
+  });
+  // a tile next to one moving too fast for it wakes up, and only counts as calm while its neighbours are calm too
+  for (size_t t = 0; t < tiles_; ++t) {
+    if (asleep_[t]) {
+      continue;
+    }
+    const uint32_t tx = static_cast<uint32_t>(t / side_), tz = static_cast<uint32_t>(t % side_);
+    bool calm = tileEnergy_[t] < energy_;
+    for (uint32_t x = tx ? tx - 1 : 0; x <= min(tx + 1, side_ - 1); ++x) {
+      for (uint32_t z = tz ? tz - 1 : 0; z <= min(tz + 1, side_ - 1); ++z) {
+        const size_t n = size_t(x) * side_ + z;
+        if (asleep_[n]) {
+          if (!(tileEnergy_[t] < energy_)) {
+            WakeTile(ps, n);
+          }
+        } else if (!(tileEnergy_[n] < energy_)) {
+          calm = false;
+        }
+      }
+    }
+    calm_[t] = calm ? calm_[t] + 1 : 0;
+  }
+  for (size_t t = 0; t < tiles_; ++t) {
+    if (!asleep_[t] && calm_[t] >= ticks_) {
+      Sleep(ps, t);
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "jobs.h"
+#include "narrowphase.h"
+#include "particles.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//the sleeping tiles after the last tick, and how often tiles changed state since the stats were last reset
+struct SleepStats {
+  //particles and tiles awake and asleep
+  size_t awakeParticles;
+  size_t sleepingParticles;
+  size_t awakeTiles;
+  size_t sleepingTiles;
+  //tiles put to sleep and woken up
+  uint64_t sleeps;
+  uint64_t wakes;
+  //ticks skipped whole because everything was asleep
+  uint64_t skippedTicks;
+};
+
+//Sleeping regions of a cloth grid. The grid is cut into square tiles, and a tile whose particles all stay under an
+//energy threshold for a number of ticks, with its neighbours calm too, goes to sleep: its particles stop and get
+//the PARTICLE_ASLEEP bit, so the integrator, the solvers, the springs and the contacts skip them like pinned ones.
+//A tile wakes when a force is applied to one of its particles, when something awake touches it, or when a tile
+//next to it moves faster than the threshold. Once every tile sleeps the physics skips the whole tick.
+class SleepTiles {
+public:
+  SleepTiles();
+  //rows x rows grid of new particles in store slots first + x * rows + z, cut in tiles of tileRows x tileRows
+  //particles, all awake
+  void Init(uint32_t first, uint32_t rows, uint32_t tileRows = 8);
+  //kinetic energy (joules) every particle of a tile has to stay under, and for how many ticks, before it sleeps
+  void SetThreshold(float energy, int ticks);
+  float Energy() const { return energy_; }
+  int Ticks() const { return ticks_; }
+
+  //wakes the tile of store slot i, if it is one of the grid's and asleep
+  void Wake(ParticleStore &ps, size_t i);
+  void WakeAll(ParticleStore &ps);
+  //drops the contacts with nothing awake in them, and wakes the sleeping particles something awake touches
+  void FilterContacts(ContactBuffer &contacts, ParticleStore &ps);
+  //after the tick: the energy of every awake tile, then the tiles that fall asleep or are woken by a neighbour
+  void Update(ParticleStore &ps, float dt, JobPool &pool);
+  //counts a tick the physics skipped
+  void Skip() { ++stats_.skippedTicks; }
+
+  //particles of the grid, and whether all of them are asleep
+  size_t Particles() const { return size_t(rows_) * rows_; }
+  bool AllAsleep() const { return stats_.sleepingTiles == tiles_ && tiles_ > 0; }
+  const SleepStats &Stats() const { return stats_; }
+  void ResetStats();
+
+private:
+  //grid rows [x0, x1) and columns [z0, z1) of tile t
+  void TileRange(size_t t, uint32_t &x0, uint32_t &x1, uint32_t &z0, uint32_t &z1) const;
+  void Sleep(ParticleStore &ps, size_t t);
+  void WakeTile(ParticleStore &ps, size_t t);
+  float TileEnergy(const ParticleStore &ps, size_t t, float dt2) const;
+
+  uint32_t first_;
+  uint32_t rows_;
+  uint32_t tileRows_;
+  //tiles per side, and in all
+  uint32_t side_;
+  size_t tiles_;
+  float energy_;
+  int ticks_;
+  //for every tile: asleep or not, ticks it has been calm for, and the largest particle energy of the last tick
+  std::vector<uint8_t> asleep_;
+  std::vector<int> calm_;
+  std::vector<float> tileEnergy_;
+  SleepStats stats_;
+};
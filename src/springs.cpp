@@ -0,0 +1,128 @@
+#include "springs.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+//colours a particle mask can track, springs that find no free colour go to the serial group
+static const uint32_t maxColors = 64;
+//springs per job when evaluated in parallel
+static const size_t springGrain = 2048;
+
+void SpringTopology::Clear() {
+  a.clear();
+  b.clear();
+  restLength.clear();
+  type.clear();
+  colorOffsets.clear();
+  serialFrom = 0;
+}
+
+void SpringTopology::Add(uint32_t first, uint32_t second, float rest, SpringClass c) {
+  a.push_back(first);
+  b.push_back(second);
+  restLength.push_back(rest);
+  type.push_back(static_cast<uint8_t>(c));
+}
+
+void EvaluateSprings(const SpringTopology &t, const SpringParams &k, ParticleStore &ps, size_t begin, size_t end) {
+  for (size_t e = begin; e < end; ++e) {
+    const uint32_t i = t.a[e];
+    const uint32_t j = t.b[e];
+    //two sleeping ends can't move, whatever the spring says
+    if (ps.pinned[i] & ps.pinned[j] & PARTICLE_ASLEEP) {
+      continue;
+    }
+    //vector from the first particle to the second one
+    const float dx = ps.px[j] - ps.px[i];
+    const float dy = ps.py[j] - ps.py[i];
+    const float dz = ps.pz[j] - ps.pz[i];
+    const float len = sqrtf(dx * dx + dy * dy + dz * dz);
+    if (len <= 0.0f) {
+      continue;
+    }
+    //stretch from the rest length times the spring constant, along the normalized direction
+    const float magnitude = (len - t.restLength[e]) * k.stiffness[t.type[e]] / len;
+    //damper opposes the relative velocity of the two particles
+    const float fx = -dx * magnitude - k.damping * ((ps.px[j] - ps.ox[j]) - (ps.px[i] - ps.ox[i]));
+    const float fy = -dy * magnitude - k.damping * ((ps.py[j] - ps.oy[j]) - (ps.py[i] - ps.oy[i]));
+    const float fz = -dz * magnitude - k.damping * ((ps.pz[j] - ps.oz[j]) - (ps.pz[i] - ps.oz[i]));
+    ps.fx[j] += fx;
+    ps.fy[j] += fy;
+    ps.fz[j] += fz;
+    ps.fx[i] -= fx;
+    ps.fy[i] -= fy;
+    ps.fz[i] -= fz;
+  }
+}
+
+void EvaluateSprings(const SpringTopology &t, const SpringParams &k, ParticleStore &ps) {
+  EvaluateSprings(t, k, ps, 0, t.Size());
+}
+
+void ColorSprings(SpringTopology &t) {
+  const size_t n = t.Size();
+  uint32_t particles = 0;
+  for (size_t e = 0; e < n; ++e) {
+    particles = max(particles, max(t.a[e], t.b[e]) + 1);
+  }
+  //colours already used around every particle
+  vector<uint64_t> used(particles, 0);
+  vector<uint32_t> color(n);
+  vector<uint32_t> count(maxColors + 1, 0);
+  for (size_t e = 0; e < n; ++e) {
+    const uint64_t taken = used[t.a[e]] | used[t.b[e]];
+    uint32_t c = 0;
+    while (c < maxColors && (taken & (uint64_t(1) << c))) {
+      ++c;
+    }
+    if (c < maxColors) {
+      used[t.a[e]] |= uint64_t(1) << c;
+      used[t.b[e]] |= uint64_t(1) << c;
+    }
+    color[e] = c;
+    ++count[c];
+  }
+  uint32_t colors = 0;
+  for (uint32_t c = 0; c < maxColors; ++c) {
+    if (count[c]) {
+      colors = c + 1;
+    }
+  }
+  //counting sort of the springs by colour, stable so neighbouring springs stay close in memory
+  vector<uint32_t> start(maxColors + 2, 0);
+  for (uint32_t c = 0; c <= maxColors; ++c) {
+    start[c + 1] = start[c] + count[c];
+  }
+  t.colorOffsets.assign(start.begin(), start.begin() + colors + 1);
+  t.serialFrom = start[maxColors];
+  SpringTopology sorted;
+  sorted.a.resize(n);
+  sorted.b.resize(n);
+  sorted.restLength.resize(n);
+  sorted.type.resize(n);
+  for (size_t e = 0; e < n; ++e) {
+    const uint32_t to = start[color[e]]++;
+    sorted.a[to] = t.a[e];
+    sorted.b[to] = t.b[e];
+    sorted.restLength[to] = t.restLength[e];
+    sorted.type[to] = t.type[e];
+  }
+  t.a.swap(sorted.a);
+  t.b.swap(sorted.b);
+  t.restLength.swap(sorted.restLength);
+  t.type.swap(sorted.type);
+}
+
+void EvaluateSpringsParallel(const SpringTopology &t, const SpringParams &k, ParticleStore &ps, JobPool &pool) {
+  if (pool.Size() == 1 || t.colorOffsets.empty()) {
+    EvaluateSprings(t, k, ps);
+    return;
+  }
+  for (size_t c = 0; c < t.Colors(); ++c) {
+    const size_t first = t.colorOffsets[c];
+    pool.ParallelFor(t.colorOffsets[c + 1] - first, springGrain,
+                     [&](size_t begin, size_t end) { EvaluateSprings(t, k, ps, first + begin, first + end); });
+  }
+  EvaluateSprings(t, k, ps, t.serialFrom, t.Size());
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "jobs.h"
+#include "particles.h"
+#include <cstdint>
+#include <vector>
+
+//stiffness class of a spring, every class has its own spring constant
+enum SpringClass { SPRING_STRETCH, SPRING_SHEAR, SPRING_BEND, SPRING_DIAGONAL_BEND, SPRING_CLASSES };
+
+//Compact edge list of springs between particle store slots.
+//Built once with the cloth, the constants live in SpringParams so changing them never rebuilds it.
+struct SpringTopology {
+  //the force is applied to b and its opposite to a
+  std::vector<uint32_t> a, b;
+  std::vector<float> restLength;
+  //SpringClass of every spring
+  std::vector<uint8_t> type;
+  //after ColorSprings: springs sorted by colour, colour c is [colorOffsets[c], colorOffsets[c + 1]).
+  //No two springs of a colour share a particle, so a colour can be evaluated in parallel.
+  std::vector<uint32_t> colorOffsets;
+  //springs from here on could not be coloured and are evaluated serially
+  size_t serialFrom;
+
+  SpringTopology() : serialFrom(0) {}
+  size_t Size() const { return a.size(); }
+  size_t Colors() const { return colorOffsets.empty() ? 0 : colorOffsets.size() - 1; }
+  void Clear();
+  void Add(uint32_t first, uint32_t second, float rest, SpringClass c);
+};
+
+//per class spring constants and the damping factor shared by every spring
+struct SpringParams {
+  float stiffness[SPRING_CLASSES];
+  float damping;
+};
+
+//reorders the springs into colour groups (greedy edge colouring), called once after building
+void ColorSprings(SpringTopology &t);
+
+//adds spring and damper forces of springs [begin, end) to the particles
+void EvaluateSprings(const SpringTopology &t, const SpringParams &k, ParticleStore &ps, size_t begin, size_t end);
+void EvaluateSprings(const SpringTopology &t, const SpringParams &k, ParticleStore &ps);
+//same as EvaluateSprings, one colour at a time spread over the pool (serial if the springs are not coloured)
+void EvaluateSpringsParallel(const SpringTopology &t, const SpringParams &k, ParticleStore &ps, JobPool &pool);
@@ -0,0 +1,75 @@
+#include "xpbd.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+//springs per job, the same as the spring forces
+static const size_t constraintGrain = 2048;
+//softest spring constant a class can have, a constant of 0 would make an infinite compliance
+static const float minStiffness = 1.0e-6f;
+
+XpbdSolver::XpbdSolver() : iterations_(8) {
+  fill(alpha_, alpha_ + SPRING_CLASSES, 0.0f);
+  fill(gamma_, gamma_ + SPRING_CLASSES, 0.0f);
+}
+
+void XpbdSolver::SetIterations(int iterations) { iterations_ = max(iterations, 1); }
+
+void XpbdSolver::Project(const SpringTopology &t, ParticleStore &ps, size_t begin, size_t end) {
+  for (size_t e = begin; e < end; ++e) {
+    const uint32_t i = t.a[e];
+    const uint32_t j = t.b[e];
+    // pinned particles have an infinite mass here
+    const float wi = ps.pinned[i] ? 0.0f : ps.invMass[i];
+    const float wj = ps.pinned[j] ? 0.0f : ps.invMass[j];
+    const float dx = ps.px[j] - ps.px[i];
+    const float dy = ps.py[j] - ps.py[i];
+    const float dz = ps.pz[j] - ps.pz[i];
+    const float len = sqrtf(dx * dx + dy * dy + dz * dz);
+    if (wi + wj <= 0.0f || len <= 0.0f) {
+      continue;
+    }
+    const float nx = dx / len, ny = dy / len, nz = dz / len;
+    const float alpha = alpha_[t.type[e]];
+    const float gamma = gamma_[t.type[e]];
+    // how fast the spring is stretching, from the displacement of both ends since the start of the tick
+    const float rate = nx * ((ps.px[j] - ps.ox[j]) - (ps.px[i] - ps.ox[i])) +
+                       ny * ((ps.py[j] - ps.oy[j]) - (ps.py[i] - ps.oy[i])) +
+                       nz * ((ps.pz[j] - ps.oz[j]) - (ps.pz[i] - ps.oz[i]));
+    const float dl = (t.restLength[e] - len - alpha * lambda_[e] - gamma * rate) / ((1.0f + gamma) * (wi + wj) + alpha);
+    lambda_[e] += dl;
+    ps.px[j] += wj * nx * dl;
+    ps.py[j] += wj * ny * dl;
+    ps.pz[j] += wj * nz * dl;
+    ps.px[i] -= wi * nx * dl;
+    ps.py[i] -= wi * ny * dl;
+    ps.pz[i] -= wi * nz * dl;
+  }
+}
+
+void XpbdSolver::Solve(const SpringTopology &t, const SpringParams &k, ParticleStore &ps, float dt, JobPool &pool) {
+  // the spring force k * stretch is a constraint of compliance 1 / k, and the damper force (damping times the
+  // displacement of a tick) is a constraint damping of damping * dt, which over the compliance gives the ratio below
+  const float dt2 = dt * dt;
+  for (int c = 0; c < SPRING_CLASSES; ++c) {
+    const float stiffness = max(k.stiffness[c], minStiffness);
+    alpha_[c] = 1.0f / (stiffness * dt2);
+    gamma_[c] = max(k.damping, 0.0f) / stiffness;
+  }
+  lambda_.assign(t.Size(), 0.0f);
+  const bool parallel = pool.Size() > 1 && !t.colorOffsets.empty();
+  for (int n = 0; n < iterations_; ++n) {
+    if (!parallel) {
+      Project(t, ps, 0, t.Size());
+      continue;
+    }
+    // a colour never moves a particle twice, the next colour sees what it did
+    for (size_t c = 0; c < t.Colors(); ++c) {
+      const size_t first = t.colorOffsets[c];
+      pool.ParallelFor(t.colorOffsets[c + 1] - first, constraintGrain,
+                       [&](size_t begin, size_t end) { Project(t, ps, first + begin, first + end); });
+    }
+    Project(t, ps, t.serialFrom, t.Size());
+  }
+}
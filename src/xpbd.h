@@ -0,0 +1,32 @@
+#pragma once
+#include "jobs.h"
+#include "particles.h"
+#include "springs.h"
+#include <vector>
+
+//Extended position based dynamics (XPBD) over the spring topology. Every spring is a distance constraint with a
+//compliance of 1 / its spring constant, so the cloth gets as stiff as with spring forces once the iterations have
+//converged (stiff cloth needs many more than soft cloth, see --bench-solvers), but the constraints are solved on the
+//positions the integrator predicted and stay stable whatever the tick length and the stiffness.
+//The damping factor becomes constraint damping along every spring. A tick's constraints are projected a colour at a
+//time, the springs of a colour in parallel, as many times over as there are iterations.
+class XpbdSolver {
+public:
+  XpbdSolver();
+  //passes over every constraint per tick, more is stiffer and costs more
+  void SetIterations(int iterations);
+  int Iterations() const { return iterations_; }
+  //moves the positions predicted for a tick of length dt until they satisfy the springs.
+  //Pinned particles don't move, velocity stays implicit in position - previous position.
+  void Solve(const SpringTopology &t, const SpringParams &k, ParticleStore &ps, float dt, JobPool &pool);
+
+private:
+  void Project(const SpringTopology &t, ParticleStore &ps, size_t begin, size_t end);
+
+  int iterations_;
+  //compliance over dt squared and damping ratio of every spring class, for the tick being solved
+  float alpha_[SPRING_CLASSES];
+  float gamma_[SPRING_CLASSES];
+  //total constraint impulse of every spring during the tick
+  std::vector<float> lambda_;
+};